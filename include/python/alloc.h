@@ -0,0 +1,31 @@
+/*
+ * Copyright 1991 by Stichting Mathematisch Centrum
+ * See `LICENCE' for more information.
+ */
+
+/* Small-object allocator interface */
+
+#ifndef PY_ALLOC_H
+#define PY_ALLOC_H
+
+#include <python/object.h>
+
+/*
+ * Objects are mostly small and short lived, so rather than going to malloc
+ * for each one, requests of up to PY_MEM_MAX bytes are served from pools of
+ * same-sized blocks carved out of large arenas. Anything bigger is passed
+ * through to malloc. Callers give the size back when freeing a block -- it
+ * must be the size it was allocated with.
+ */
+
+#define PY_MEM_ALIGN (8) /* Block sizes are multiples of this */
+#define PY_MEM_MAX (512) /* Largest request served from a pool */
+
+void* py_mem_alloc(size_t);
+void py_mem_free(void*, size_t);
+
+#ifdef PY_REF_DEBUG
+void py_mem_print_stats(FILE*);
+#endif
+
+#endif
@@ -10,6 +10,7 @@
 
 #include <python/node.h>
 #include <python/bitset.h>
+#include <python/opcode.h>
 
 #include <python/object.h>
 
@@ -20,17 +21,37 @@
  * - and a list of the names used.
  */
 
+/*
+ * Cache for the LOAD_NAME instructions of one name. The entry the name
+ * resolved to stays valid while the locals, globals and builtins dicts keep
+ * the versions they had when it was looked up.
+ */
+struct py_name_cache {
+	unsigned long locals;
+	unsigned long globals;
+	unsigned long builtins;
+	struct py_dictentry* entry;
+};
+
 struct py_code {
 	struct py_object ob;
 
-	py_byte_t* code; /* instruction opcodes */
+	py_code_unit_t* code; /* instructions, see `opcode.h' */
+	py_byte_t* lines; /* line number table, see `py_code_get_line' */
+	unsigned nlines; /* size of lines in bytes */
 	/* TODO: Do these need to be objects? */
 	struct py_object* consts; /* list of immutable constant objects */
 	struct py_object* names; /* list of stringobjects */
 	struct py_object* filename; /* string */
+	struct py_name_cache* cache; /* per-name caches, allocated on first run */
+	int fast; /* locals live in frame slots rather than a dict */
+	unsigned stacksize; /* deepest the value stack gets */
+	unsigned blocksize; /* deepest the block stack gets */
 };
 
 struct py_code* py_compile(struct py_node*, const char*);
 void py_code_dealloc(struct py_object*);
 
+unsigned py_code_get_line(struct py_code*, unsigned);
+
 #endif
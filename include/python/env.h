@@ -22,4 +22,14 @@ enum asys_result py_open_r(const char*, struct asys_stream**);
 # define PY_FALLTHROUGH
 #endif
 
+#if defined(__GNUC__)
+# define PY_INLINE static __inline__
+#elif defined(_MSC_VER)
+# define PY_INLINE static __inline
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+# define PY_INLINE static inline
+#else
+# define PY_INLINE static
+#endif
+
 #endif
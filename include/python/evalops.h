@@ -36,12 +36,14 @@ struct py_object* py_apply_slice(
 
 int py_slice_index(struct py_object*, unsigned*);
 
-struct py_object* py_loop_subscript(struct py_object*, struct py_object*);
+struct py_object* py_loop_subscript(struct py_object*, unsigned);
 
-struct py_object* py_object_get_attr(struct py_object*, const char*);
+/* Attribute names are string objects, ideally interned. */
+struct py_object* py_object_get_attr(struct py_object*, struct py_object*);
 
 /* v.name = u */
-int py_object_set_attr(struct py_object*, const char*, struct py_object*);
+int py_object_set_attr(
+		struct py_object*, struct py_object*, struct py_object*);
 
 struct py_object* py_call_function(
 		struct py_env*, struct py_object*, struct py_object*);
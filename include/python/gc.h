@@ -0,0 +1,89 @@
+/*
+ * Copyright 1991 by Stichting Mathematisch Centrum
+ * See `LICENCE' for more information.
+ */
+
+/* Cycle collector interface */
+
+#ifndef PY_GC_H
+#define PY_GC_H
+
+#include <python/object.h>
+#include <python/alloc.h>
+
+/*
+ * Reference counting alone never frees objects which refer to each other in
+ * a cycle -- an instance holding a method bound to itself, say. With
+ * PY_CYCLE_GC defined, objects of the container types (those with a
+ * `traverse' method) are allocated with a header linking them into one of
+ * PY_GC_GENERATIONS lists, and are periodically searched for groups that
+ * nothing outside the group refers to.
+ *
+ * New objects start in the youngest generation, which is collected once it
+ * has grown by its threshold. Survivors of a collection move on to the next
+ * generation, which is in turn collected after its threshold's worth of
+ * collections of the one before. A threshold of 0 stops that generation
+ * (and the ones after it) from being collected automatically.
+ *
+ * The oldest generation can get big, so collecting it at once can make for a
+ * long pause. Given a time budget, the collector instead goes over it a
+ * slice at a time -- each slice with everything reachable from it, so that
+ * it holds any cycle it has a part of -- stopping each time the budget is
+ * spent and carrying on at the next collection.
+ *
+ * Collections only happen at PY_GC_POLL(), which the interpreter reaches
+ * between instructions -- where every object is fully constructed -- or when
+ * asked for.
+ */
+
+#define PY_GC_GENERATIONS (3)
+
+#ifdef PY_CYCLE_GC
+struct py_gc_head {
+	struct py_gc_head* next;
+	struct py_gc_head* prev;
+
+	unsigned refs; /* References from outside, while being collected */
+	unsigned gen; /* Generation, or state while being collected */
+};
+
+#define PY_GC_HEAD(op) ((struct py_gc_head*) (op) - 1)
+
+struct py_gc_stats {
+	unsigned long collections;
+	unsigned long slices; /* Incremental collections, the oldest only */
+	unsigned long collected; /* Objects freed */
+};
+
+/* TODO: Python global state. */
+extern int py_gc_pending;
+extern struct py_gc_stats py_gc_stats[PY_GC_GENERATIONS];
+
+void* py_gc_alloc(size_t);
+void py_gc_free(void*, size_t);
+
+void py_gc_track(void*);
+void py_gc_untrack(void*);
+
+void py_gc_poll(void);
+unsigned long py_gc_collect(unsigned);
+unsigned long py_gc_step(unsigned long);
+
+void py_gc_set_threshold(unsigned, unsigned);
+void py_gc_set_budget(unsigned long);
+
+void py_gc_print_stats(FILE*);
+
+# define PY_GC_POLL() \
+		do { if(py_gc_pending) py_gc_poll(); } while(0)
+#else
+# define py_gc_alloc py_mem_alloc
+# define py_gc_free py_mem_free
+
+# define py_gc_track(op) ((void) (op))
+# define py_gc_untrack(op) ((void) (op))
+
+# define PY_GC_POLL() ((void) 0)
+#endif
+
+#endif
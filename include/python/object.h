@@ -9,6 +9,7 @@
 #define PY_OBJECT_H
 
 #include <python/std.h>
+#include <python/env.h>
 
 /*
  * Objects are structures allocated on the heap. Special rules apply to
@@ -54,12 +55,19 @@
  *
  */
 
+/*
+ * Development builds count and check references (PY_REF_DEBUG), at the cost
+ * of a function call per reference taken or dropped; release builds do the
+ * counting inline. Define PY_REF_DEBUG to keep the checks in a release build.
+ */
 #ifndef NDEBUG
 /* Turn on heavy reference debugging */
 /* TODO: Fix this */
 /* # define PY_REF_TRACE */
 /* Turn on reference counting */
-# define PY_REF_DEBUG
+# ifndef PY_REF_DEBUG
+#  define PY_REF_DEBUG
+# endif
 #endif
 
 enum py_type {
@@ -84,6 +92,7 @@ enum py_type {
 	PY_TYPE_TUPLE,
 	PY_TYPE_LIST,
 	PY_TYPE_STRING,
+	PY_TYPE_RANGE,
 
 	PY_TYPE_DICT,
 
@@ -93,10 +102,19 @@ enum py_type {
 	PY_TYPE_MAX
 };
 
-/* TODO: Object pool to avoid malloc/free constantly. */
+/*
+ * Every object starts with the same 8 bytes: its type in the low byte of the
+ * first word and its reference count in the second. Variable-size objects
+ * keep their item count in the rest of the first word, which bounds them to
+ * PY_VAROBJECT_MAX items -- the header costs them nothing over a fixed-size
+ * object's, and the items that follow it start 8 bytes in.
+ */
+
+#define PY_VAROBJECT_MAX (0xFFFFFF)
 
 struct py_object {
-	enum py_type type;
+	unsigned type : 8; /* enum py_type */
+	unsigned : 24;
 
 	unsigned refcount;
 
@@ -106,12 +124,11 @@ struct py_object {
 #endif
 };
 
-/* TODO: This might not need to exist (and entails a gap). */
 struct py_varobject {
-	enum py_type type;
+	unsigned type : 8;
+	unsigned size : 24;
 
 	unsigned refcount;
-	unsigned size;
 
 #ifdef PY_REF_TRACE
 	struct py_object* next;
@@ -140,8 +157,36 @@ typedef struct py_object* (*py_cat_t)(struct py_object*, struct py_object*);
 typedef struct py_object* (*py_ind_t)(struct py_object*, unsigned);
 typedef struct py_object* (*py_slice_t)(struct py_object*, unsigned, unsigned);
 
+/*
+ * A traverse method calls the visitor with the address of each slot in the
+ * object holding a reference to another (possibly nil) object, so that the
+ * cycle collector can follow references and -- by emptying the slots -- break
+ * them. Only container types, which may end up in a reference cycle, have one.
+ */
+typedef void (*py_visit_t)(struct py_object**, void*);
+typedef void (*py_traverse_t)(struct py_object*, py_visit_t, void*);
+
+/*
+ * A hash method gives a hash of the object's value, the same for any two
+ * objects which compare equal, for keying dicts. Only immutable types have
+ * one -- see `py_object_hash'.
+ */
+typedef unsigned long (*py_hash_t)(struct py_object*);
+
+/*
+ * Multiplying by this odd constant -- 2^N over the golden ratio -- carries
+ * every bit of a number into the top bits of the product, and leaves the low
+ * bits of consecutive numbers all different.
+ */
+#if ULONG_MAX > 0xFFFFFFFFUL
+# define PY_HASH_MULTIPLIER (0x9E3779B97F4A7C15UL)
+#else
+# define PY_HASH_MULTIPLIER (0x9E3779B9UL)
+#endif
+
 struct py_type_info {
 	unsigned size; /* For allocation */
+	unsigned itemsize; /* "" -- per item, for varobjects holding their items */
 
 	/* Methods to implement standard operations */
 	py_dealloc_t dealloc;
@@ -150,11 +195,31 @@ struct py_type_info {
 	py_cat_t cat;
 	py_ind_t ind;
 	py_slice_t slice;
+
+	py_traverse_t traverse;
+	py_hash_t hash;
 };
 
 /* TODO: Python global state. */
 extern struct py_type_info py_types[PY_TYPE_MAX];
 
+/*
+ * With PY_TAGGED_INT defined, integers small enough are not allocated at all
+ * but carried in the object pointer itself, with the low bit set -- which no
+ * real object's address has (see object/int.h). Such a pointer has no header
+ * to read, so code that may be handed an integer must ask for its type with
+ * PY_TYPE() rather than through `->type'.
+ */
+#ifdef PY_TAGGED_INT
+# define PY_IS_TAGGED(op) ((size_t) (op) & 1)
+# define PY_TYPE(op) \
+		(PY_IS_TAGGED(op) ? \
+			PY_TYPE_INT : ((const struct py_object*) (op))->type)
+#else
+# define PY_IS_TAGGED(op) (0)
+# define PY_TYPE(op) (((const struct py_object*) (op))->type)
+#endif
+
 /* Generic operations on objects */
 
 /*
@@ -169,8 +234,10 @@ extern struct py_type_info py_types[PY_TYPE_MAX];
 
 /* `void*' for convenience's sake. */
 void* py_object_new(enum py_type);
+void* py_varobject_new(enum py_type, unsigned);
 void py_object_delete(struct py_object*);
 int py_object_cmp(const struct py_object*, const struct py_object*);
+int py_object_hash(struct py_object*, unsigned long*);
 
 int py_is_varobject(const void*);
 unsigned py_varobject_size(const void*);
@@ -182,7 +249,8 @@ unsigned py_varobject_size(const void*);
  * this can be the standard function free(). Both macros can be used
  * wherever a void expression is allowed. The argument shouldn't be a
  * NIL pointer. py_object_newref is used only to initialize reference
- * counts to 1; it is defined here for convenience.
+ * counts to 1; it is defined here for convenience. Tagged integers carry no
+ * reference count and are passed through untouched.
  *
  * We assume that the reference count field can never overflow; this can
  * be proven when the size of the field is the same as the pointer size
@@ -207,11 +275,67 @@ unsigned py_varobject_size(const void*);
 extern long py_ref_total;
 #endif
 
-void* py_object_incref(void*);
-void* py_object_decref(void*);
+/*
+ * An object whose reference count has PY_REFCOUNT_IMMORTAL set lives as long
+ * as the program: py_object_incref and py_object_decref leave it alone, so
+ * its count is never written to and it is never freed. The singletons are
+ * so from the start; `py_object_immortalise' makes any other object so for
+ * good, dropping the references held to it until then.
+ */
+#define PY_REFCOUNT_IMMORTAL (~(~0U >> 1))
+
+#define PY_IS_IMMORTAL(op) \
+		(((const struct py_object*) (op))->refcount & PY_REFCOUNT_IMMORTAL)
+
+#ifdef PY_REF_DEBUG
+void* py_object_incref_impl(void*);
+void* py_object_decref_impl(void*);
+#endif
 
 void* py_object_newref(void*);
 void py_object_unref(void*);
+void py_object_immortalise(void*);
+void py_object_dealloc(struct py_object*);
+
+PY_INLINE void* py_object_incref(void* p) {
+	if(!p || PY_IS_TAGGED(p) || PY_IS_IMMORTAL(p)) return p;
+
+#ifdef PY_REF_DEBUG
+	return py_object_incref_impl(p);
+#else
+	((struct py_object*) p)->refcount++;
+
+	return p;
+#endif
+}
+
+PY_INLINE void* py_object_decref(void* p) {
+	if(!p || PY_IS_TAGGED(p) || PY_IS_IMMORTAL(p)) return p;
+
+#ifdef PY_REF_DEBUG
+	return py_object_decref_impl(p);
+#else
+	if(!--((struct py_object*) p)->refcount) py_object_dealloc(p);
+
+	return p;
+#endif
+}
+
+/*
+ * Freeing a container drops the references it holds, which may free other
+ * containers in turn -- a big or deep structure going away takes as long as
+ * it is big and recurses as deep as it is deep, all at once. With deferred
+ * freeing turned on, tuples, lists and dicts which lose their last reference
+ * are instead queued, to be freed when the host drains the queue; each one
+ * freed then queues those it held the last reference to, and big lists and
+ * dicts are let go of a chunk at a time. A drain stops after the given
+ * number of steps or microseconds, whichever comes first (0 leaving either
+ * unbounded), so that teardown can be spread over as many drains -- once a
+ * frame, say -- as it takes. Memory queued stays in use until drained.
+ */
+void py_object_set_deferred(int);
+unsigned long py_object_drain(unsigned long, unsigned long);
+unsigned py_object_pending(void);
 
 #ifdef PY_REF_TRACE
 void py_print_refs(FILE*);
@@ -34,16 +34,20 @@ struct py_class_method {
 };
 
 struct py_object* py_class_new(struct py_object*);
-struct py_object* py_class_get_attr(struct py_object*, const char*);
+struct py_object* py_class_get_attr(struct py_object*, struct py_object*);
 void py_class_dealloc(struct py_object*);
+void py_class_traverse(struct py_object*, py_visit_t, void*);
 
 struct py_object* py_class_member_new(struct py_object*);
-struct py_object* py_class_member_get_attr(struct py_object*, const char*);
+struct py_object* py_class_member_get_attr(
+		struct py_object*, struct py_object*);
 void py_class_member_dealloc(struct py_object*);
+void py_class_member_traverse(struct py_object*, py_visit_t, void*);
 
 struct py_object* py_class_method_new(struct py_object*, struct py_object*);
 struct py_object* py_class_method_get_func(struct py_object*);
 struct py_object* py_class_method_get_self(struct py_object*);
 void py_class_method_dealloc(struct py_object*);
+void py_class_method_traverse(struct py_object*, py_visit_t, void*);
 
 #endif
@@ -4,8 +4,11 @@
  */
 
 /*
- * Dictionary object type -- mapping from char * to object.
- * NB: the key is given as a char *, not as a struct py_string.
+ * Dictionary object type -- mapping from hashable object to object.
+ * NB: the key is given as a char *, standing for a string key, except to the
+ * `_object' and `_entry' lookups, py_dict_assign() and py_dict_insert_many(),
+ * which take key objects (string objects using the hash cached with them),
+ * and to py_dict_lookup_int(), which takes an int key's value.
  * These functions set errno for errors. Functions py_dict_remove() and
  * py_dict_insert() return nonzero for errors, py_dict_size() returns -1,
  * the others NULL. A successful call to py_dict_insert() calls py_object_incref()
@@ -16,38 +19,56 @@
 #define PY_DICTOBJECT_H
 
 #include <python/object.h>
+#include <python/object/int.h>
 
 /*
- * Invariant for entries: when in use, value is not NULL and key is
- * not NULL and not dummy; when not in use, value is NULL and key
- * is either NULL or dummy. A dummy key value cannot be replaced by NULL,
- * since otherwise other keys may be lost.
+ * Entries are kept in the order their keys were first inserted. Removing a
+ * key clears its entry -- key and value both NULL -- which stays in place
+ * until the table is next rebuilt.
  */
 struct py_dictentry {
 	struct py_object* key;
 	struct py_object* value;
+	unsigned long hash; /* of the key, while it is not NULL */
 };
 
+/*
+ * The version of a dict is replaced by a new, never before used value
+ * whenever its set of keys or the location of its entries changes. Storing a
+ * new value under an existing key keeps the version. Equal versions therefore
+ * mean the same dict with its entries in the same place, which lets callers
+ * cache entry pointers against it.
+ */
 struct py_dict {
 	struct py_object ob;
 
-	unsigned fill;
-	unsigned used;
-	unsigned size;
+	unsigned fill; /* entries taken, cleared ones included */
+	unsigned used; /* entries in use */
+	unsigned size; /* slots in the index, a power of two */
+	unsigned long version;
 
+	void* index; /* slots holding entry numbers, in one block with the table */
 	struct py_dictentry* table;
 };
 
 struct py_object* py_dict_new(void);
+struct py_object* py_dict_new_sized(unsigned);
 
 struct py_object* py_dict_lookup(struct py_object*, const char*);
+struct py_object* py_dict_lookup_int(struct py_object*, py_value_t);
+struct py_dictentry* py_dict_lookup_entry(
+		struct py_object*, struct py_object*);
 struct py_object* py_dict_lookup_object(struct py_object*, struct py_object*);
 int py_dict_assign(struct py_object*, struct py_object*, struct py_object*);
 int py_dict_insert(struct py_object*, const char*, struct py_object*);
+int py_dict_insert_many(
+		struct py_object*, struct py_object**, struct py_object**, unsigned);
+int py_dict_reserve(struct py_object*, unsigned);
 int py_dict_remove(struct py_object*, const char*);
 unsigned py_dict_size(struct py_object*);
 const char* py_dict_get_key(struct py_object*, unsigned);
 void py_dict_dealloc(struct py_object*);
+void py_dict_traverse(struct py_object*, py_visit_t, void*);
 
 void py_done_dict(void);
 
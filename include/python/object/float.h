@@ -21,7 +21,9 @@ struct py_float {
 
 struct py_object* py_float_new(double);
 void py_float_dealloc(struct py_object*);
+void py_float_done(void);
 double py_float_get(const struct py_object*);
 int py_float_cmp(const struct py_object*, const struct py_object*);
+unsigned long py_float_hash(struct py_object*);
 
 #endif
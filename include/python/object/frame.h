@@ -15,6 +15,7 @@ struct py_block {
 	enum py_opcode type; /* what kind of block this is */
 	unsigned handler; /* where to jump to find handler */
 	unsigned level; /* value stack level to pop to */
+	unsigned index; /* next item of a for loop's sequence */
 };
 
 struct py_frame {
@@ -25,10 +26,12 @@ struct py_frame {
 	struct py_code* code; /* code segment */
 	struct py_object* globals; /* global symbol table (struct py_dict) */
 	struct py_object* locals; /* local symbol table (struct py_dict) */
-	struct py_object** valuestack; /* malloc'ed array */
-	struct py_block* blockstack; /* malloc'ed array */
+	struct py_object** fastlocals; /* slot array, if code->fast */
+	struct py_object** valuestack; /* follows the frame in memory */
+	struct py_block* blockstack; /* "" */
 	unsigned nblocks; /* size of blockstack */
 	unsigned iblock; /* index in blockstack */
+	unsigned bucket; /* size class of the frame's allocation */
 };
 
 /* Standard object interface */
@@ -37,9 +40,13 @@ struct py_frame* py_frame_new(
 		struct py_frame*, struct py_code*, struct py_object*,
 		struct py_object*, unsigned, unsigned);
 void py_frame_dealloc(struct py_object*);
+void py_frame_traverse(struct py_object*, py_visit_t, void*);
+void py_frame_done(void);
 
 /* The rest of the interface is specific for frame objects */
 
+struct py_object* py_frame_get_locals(struct py_frame*);
+
 /* Block management functions */
 void py_block_setup(struct py_frame*, enum py_opcode, unsigned, unsigned);
 struct py_block* py_block_pop(struct py_frame*);
@@ -16,5 +16,6 @@ struct py_func {
 
 struct py_object* py_func_new(struct py_object*, struct py_object*);
 void py_func_dealloc(struct py_object*);
+void py_func_traverse(struct py_object*, py_visit_t, void*);
 
 #endif
@@ -28,6 +28,33 @@
 
 typedef asys_native_long_t py_value_t;
 
+/*
+ * Under PY_TAGGED_INT, `py_int_new' hands back values which fit in 62 bits
+ * and a sign as tagged pointers -- `(value << 1) | 1' -- instead of heap
+ * objects, so that integer arithmetic needs no allocation. Only values out
+ * of that range, and the two Booleans, are real `struct py_int's.
+ */
+#ifdef PY_TAGGED_INT
+# define PY_INT_TAGGED_MAX ((py_value_t) ((size_t) -1 >> 2))
+# define PY_INT_TAGGED_MIN (-PY_INT_TAGGED_MAX - 1)
+
+# define PY_INT_TAG(value) \
+		((struct py_object*) (((size_t) (value) << 1) | 1))
+# define PY_INT_UNTAG(op) ((py_value_t) ((ptrdiff_t) (op) >> 1))
+#endif
+
+/*
+ * Otherwise, `py_int_new' returns integers in [PY_INT_SMALL_MIN,
+ * PY_INT_SMALL_MAX] from a table filled by `py_int_init' whose entries are
+ * immortal. Either bound can be overridden at build time.
+ */
+#ifndef PY_INT_SMALL_MIN
+# define PY_INT_SMALL_MIN (-16)
+#endif
+#ifndef PY_INT_SMALL_MAX
+# define PY_INT_SMALL_MAX (1024)
+#endif
+
 struct py_int {
 	struct py_object ob;
 	py_value_t value;
@@ -36,10 +63,21 @@ struct py_int {
 # pragma GCC diagnostic pop
 #endif
 
+/*
+ * The hash of an integer, which `py_dict_lookup_int' works out from the value
+ * alone, without an object to hand.
+ */
+PY_INLINE unsigned long py_int_hash_value(py_value_t value) {
+	return (unsigned long) value * PY_HASH_MULTIPLIER;
+}
+
+void py_int_init(void);
+
 struct py_object* py_int_new(py_value_t);
 py_value_t py_int_get(const struct py_object*);
 
 int py_int_cmp(const struct py_object*, const struct py_object*);
+unsigned long py_int_hash(struct py_object*);
 void py_int_dealloc(struct py_object*);
 
 /*
@@ -54,6 +92,11 @@ void py_int_dealloc(struct py_object*);
 /* Don't use these directly */
 extern struct py_int py_false_object, py_true_object;
 
+#ifdef PY_REF_DEBUG
+/* TODO: Python global state. */
+extern long py_int_alloc_total; /* Integers allocated */
+#endif
+
 #define PY_TRUE ((struct py_object*) &py_true_object)
 #define PY_FALSE ((struct py_object*) &py_false_object)
 
@@ -34,6 +34,7 @@ int py_list_insert(struct py_object*, unsigned, struct py_object*);
 int py_list_add(struct py_object*, struct py_object*);
 
 void py_list_dealloc(struct py_object*);
+void py_list_traverse(struct py_object*, py_visit_t, void*);
 int py_list_cmp(const struct py_object*, const struct py_object*);
 
 struct py_object* py_list_cat(struct py_object*, struct py_object*);
@@ -27,5 +27,6 @@ struct py_method {
 
 struct py_object* py_method_new(py_method_t, struct py_object*);
 void py_method_dealloc(struct py_object*);
+void py_method_traverse(struct py_object*, py_visit_t, void*);
 
 #endif
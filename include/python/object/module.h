@@ -28,7 +28,8 @@ struct py_object* py_module_new(const char*);
 struct py_object* py_module_new_methods(
 		struct py_env*, const char*, const struct py_methodlist*);
 
-struct py_object* py_module_get_attr(struct py_object*, const char*);
+struct py_object* py_module_get_attr(struct py_object*, struct py_object*);
 void py_module_dealloc(struct py_object*);
+void py_module_traverse(struct py_object*, py_visit_t, void*);
 
 #endif
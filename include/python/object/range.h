@@ -0,0 +1,40 @@
+/*
+ * Copyright 1991 by Stichting Mathematisch Centrum
+ * See `LICENCE' for more information.
+ */
+
+/* Range object interface */
+
+#ifndef PY_RANGEOBJECT_H
+#define PY_RANGEOBJECT_H
+
+#include <python/object.h>
+
+#include <python/object/int.h>
+
+/*
+ * A range is the immutable arithmetic sequence start, start + step, ... of
+ * `length' integers, which a for loop over `range(...)' goes through instead
+ * of the list `range' returns (see PY_OP_LOOP_CALL). Items are made on
+ * demand, so a range costs the same however long it is -- which is why its
+ * length is kept apart from the header's item count, as it may well exceed
+ * PY_VAROBJECT_MAX.
+ */
+
+struct py_range {
+	struct py_varobject ob;
+	unsigned length;
+	py_value_t start;
+	py_value_t step;
+};
+
+struct py_object* py_range_new(py_value_t, py_value_t, unsigned);
+py_value_t py_range_get(const struct py_object*, unsigned);
+
+void py_range_dealloc(struct py_object*);
+int py_range_cmp(const struct py_object*, const struct py_object*);
+
+struct py_object* py_range_ind(struct py_object*, unsigned);
+struct py_object* py_range_slice(struct py_object*, unsigned, unsigned);
+
+#endif
@@ -25,11 +25,18 @@
  * functions should be applied to nil objects.
  */
 
+/*
+ * Interning maps every value to one string object, held for good by the
+ * intern table -- names made with `py_string_intern' compare equal exactly
+ * when they are the same object.
+ */
+
 /* NB The type is revealed here only because it is used in dictobject.c */
 
 struct py_string {
 	struct py_varobject ob;
-	char value[1]; /* TODO: Is this supposed to be sized? FAM? */
+	unsigned long hash; /* 0 until first asked for */
+	char value[]; /* `ob.size' characters and a terminating NUL */
 };
 
 struct py_object* py_string_new_size(const char*, unsigned);
@@ -37,10 +44,18 @@ struct py_object* py_string_new(const char*);
 void py_string_dealloc(struct py_object*);
 const char* py_string_get(const struct py_object*);
 
+unsigned long py_string_hash_size(const char*, unsigned);
+unsigned long py_string_hash(struct py_object*);
+
+struct py_object* py_string_intern(const char*);
+int py_string_intern_object(struct py_object**);
+
 struct py_object* py_string_cat(struct py_object*, struct py_object*);
 struct py_object* py_string_ind(struct py_object*, unsigned);
 struct py_object* py_string_slice(struct py_object*, unsigned, unsigned);
 
 int py_string_cmp(const struct py_object*, const struct py_object*);
 
+void py_string_done(void);
+
 #endif
@@ -26,7 +26,7 @@
 
 struct py_tuple {
 	struct py_varobject ob;
-	struct py_object* item[1]; /* TODO: FAM? */
+	struct py_object* item[];
 };
 
 struct py_object* py_tuple_new(unsigned);
@@ -34,7 +34,10 @@ struct py_object* py_tuple_get(const struct py_object*, unsigned);
 void py_tuple_set(struct py_object*, unsigned, struct py_object*);
 
 void py_tuple_dealloc(struct py_object*);
+void py_tuple_done(void);
+void py_tuple_traverse(struct py_object*, py_visit_t, void*);
 int py_tuple_cmp(const struct py_object*, const struct py_object*);
+unsigned long py_tuple_hash(struct py_object*);
 
 struct py_object* py_tuple_cat(struct py_object*, struct py_object*);
 struct py_object* py_tuple_ind(struct py_object*, unsigned);
@@ -8,6 +8,20 @@
 #ifndef PY_OPCODE_H
 #define PY_OPCODE_H
 
+/*
+ * Instructions are one aligned 32-bit word each -- the opcode in the low 8
+ * bits and the argument in the upper 24. Code offsets, including those in
+ * jump arguments, count instructions rather than bytes.
+ */
+typedef unsigned py_code_unit_t;
+
+#define PY_CODE_ARG_MAX (0xFFFFFF)
+
+#define PY_CODE_UNIT(op, arg) \
+	((py_code_unit_t) (op) | ((py_code_unit_t) (arg) << 8))
+#define PY_CODE_OP(unit) ((unit) & 0xFF)
+#define PY_CODE_ARG(unit) ((unit) >> 8)
+
 /*
  * TODO: We can pack this into a byte (or even half bytes!) when we get to
  * 		 Emitting static bytecode.
@@ -29,6 +43,20 @@ enum py_opcode {
 	PY_OP_BINARY_SUBTRACT = 24,
 	PY_OP_BINARY_SUBSCR = 25,
 	PY_OP_BINARY_CALL = 26,
+	PY_OP_LOOP_CALL = 27, /* BINARY_CALL making a for loop's sequence */
+
+	/*
+	 * Type-specialised forms of the arithmetic opcodes. The compiler never
+	 * emits these -- `py_code_eval' rewrites a generic instruction into one
+	 * in place once it has seen its operand types, and back again when a
+	 * later execution sees different ones.
+	 */
+	PY_OP_BINARY_MULTIPLY_INT = 40,
+	PY_OP_BINARY_MULTIPLY_FLOAT = 41,
+	PY_OP_BINARY_ADD_INT = 42,
+	PY_OP_BINARY_ADD_FLOAT = 43,
+	PY_OP_BINARY_SUBTRACT_INT = 44,
+	PY_OP_BINARY_SUBTRACT_FLOAT = 45,
 
 	PY_OP_SLICE = 30,
 	/* Also uses 31-33 */
@@ -58,23 +86,28 @@ enum py_opcode {
 	PY_OP_LOAD_NAME = 101, /* Index in name list */
 	PY_OP_BUILD_TUPLE = 102, /* Number of tuple items */
 	PY_OP_BUILD_LIST = 103, /* Number of list items */
-	PY_OP_BUILD_MAP = 104, /* Always zero for now */
+	PY_OP_BUILD_MAP = 104, /* Entries to size for -- always zero for now */
 	PY_OP_LOAD_ATTR = 105, /* Index in name list */
 	PY_OP_COMPARE_OP = 106, /* Comparison operator */
 	PY_OP_IMPORT_NAME = 107, /* Index in name list */
 	PY_OP_IMPORT_FROM = 108, /* Index in name list */
 
-	PY_OP_JUMP_FORWARD = 110, /* Number of bytes to skip */
+	PY_OP_JUMP_FORWARD = 110, /* Number of instructions to skip */
 	PY_OP_JUMP_IF_FALSE = 111, /* "" */
 	PY_OP_JUMP_IF_TRUE = 112, /* "" */
-	PY_OP_JUMP_ABSOLUTE = 113, /* Target byte offset from beginning of code */
-	PY_OP_FOR_LOOP = 114, /* Number of bytes to skip */
+	/* Target instruction index from beginning of code */
+	PY_OP_JUMP_ABSOLUTE = 113,
+	PY_OP_FOR_LOOP = 114, /* Number of instructions to skip */
+
+	/* Specialised forms of PY_OP_COMPARE_OP, as above */
+	PY_OP_COMPARE_INT = 116, /* Comparison operator */
+	PY_OP_COMPARE_FLOAT = 117, /* "" */
 
 	PY_OP_SETUP_LOOP = 120, /* Target address (absolute) */
 	PY_OP_SETUP_EXCEPT = 121, /* "" */
 
-	/* TODO: Disable compiling this opcode in dist? */
-	PY_OP_SET_LINENO = 127 /* Current line number */
+	PY_OP_LOAD_FAST = 124, /* Index in name list, which is also the slot */
+	PY_OP_STORE_FAST = 125 /* "" */
 };
 
 /* Comparison operator codes (argument to PY_OP_COMPARE_OP) */
@@ -0,0 +1,270 @@
+/*
+ * Copyright 1991 by Stichting Mathematisch Centrum
+ * See `LICENCE' for more information.
+ */
+
+/* Small-object allocator implementation */
+
+#include <python/std.h>
+#include <python/alloc.h>
+
+/*
+ * Memory is taken from malloc an arena at a time and divided into pools,
+ * each aligned to its own size so that the pool a block belongs to can be
+ * found by masking the block's address. A pool serves blocks of one size
+ * class only and starts with a header describing them. Pools with blocks
+ * to spare are kept on a list per class; released blocks are chained
+ * through their first word. A pool whose blocks have all been released
+ * goes back to its arena for any class to reuse, and an arena with no pools
+ * in use is given back to malloc.
+ */
+
+#define PY_MEM_POOL (4096) /* Pool size and alignment */
+#define PY_MEM_POOLS (64) /* Pools per arena */
+#define PY_MEM_CLASSES (PY_MEM_MAX / PY_MEM_ALIGN)
+
+#define PY_MEM_ROUND(n) \
+		(((n) + PY_MEM_ALIGN - 1) & ~((size_t) PY_MEM_ALIGN - 1))
+
+struct py_mem_arena;
+
+struct py_mem_pool {
+	struct py_mem_pool* next; /* in its class's or arena's list */
+	struct py_mem_pool* prev;
+	struct py_mem_arena* arena;
+	void* free; /* released blocks */
+	unsigned size; /* block size, 0 while the pool is unused */
+	unsigned used; /* blocks handed out */
+	unsigned top; /* offset of the first block never handed out */
+};
+
+struct py_mem_arena {
+	struct py_mem_arena* next;
+	struct py_mem_arena* prev;
+	void* base; /* as returned by malloc */
+	char* pools; /* first pool, aligned */
+	struct py_mem_pool* free; /* released pools */
+	unsigned carved; /* pools handed out at least once */
+	unsigned used; /* pools holding blocks */
+};
+
+#define PY_MEM_HEADER PY_MEM_ROUND(sizeof(struct py_mem_pool))
+
+#define PY_MEM_POOL_OF(p) \
+		((struct py_mem_pool*) ((size_t) (p) & ~((size_t) PY_MEM_POOL - 1)))
+
+/* TODO: Python global state. */
+static struct py_mem_pool* py_mem_usable[PY_MEM_CLASSES];
+static struct py_mem_arena* py_mem_arenas;
+static struct py_mem_arena* py_mem_current; /* where pools come from first */
+
+#ifdef PY_REF_DEBUG
+/* TODO: Python global state. */
+static unsigned long py_mem_pooled; /* requests served by a pool */
+static unsigned long py_mem_reused; /* "" with a released block */
+static unsigned long py_mem_large; /* requests passed on to malloc */
+#endif
+
+static int py_mem_arena_full(struct py_mem_arena* arena) {
+	return !arena->free && arena->carved == PY_MEM_POOLS;
+}
+
+static struct py_mem_arena* py_mem_arena_new(void) {
+	struct py_mem_arena* arena;
+	size_t pools;
+
+	if(!(arena = malloc(sizeof(struct py_mem_arena)))) return 0;
+
+	/* One pool extra to leave room for aligning the first. */
+	if(!(arena->base = malloc((PY_MEM_POOLS + 1) * PY_MEM_POOL))) {
+		free(arena);
+		return 0;
+	}
+
+	pools = ((size_t) arena->base + PY_MEM_POOL - 1);
+	arena->pools = (char*) (pools & ~((size_t) PY_MEM_POOL - 1));
+
+	arena->free = 0;
+	arena->carved = 0;
+	arena->used = 0;
+
+	arena->prev = 0;
+	arena->next = py_mem_arenas;
+	if(py_mem_arenas) py_mem_arenas->prev = arena;
+	py_mem_arenas = arena;
+
+	return arena;
+}
+
+static void py_mem_arena_delete(struct py_mem_arena* arena) {
+	if(arena->prev) arena->prev->next = arena->next;
+	else py_mem_arenas = arena->next;
+
+	if(arena->next) arena->next->prev = arena->prev;
+
+	free(arena->base);
+	free(arena);
+}
+
+/* Takes an unused pool, from wherever one can be had. */
+static struct py_mem_pool* py_mem_pool_new(void) {
+	struct py_mem_arena* arena = py_mem_current;
+	struct py_mem_pool* pool;
+
+	if(!arena || py_mem_arena_full(arena)) {
+		for(arena = py_mem_arenas; arena; arena = arena->next) {
+			if(!py_mem_arena_full(arena)) break;
+		}
+
+		if(!arena && !(arena = py_mem_arena_new())) return 0;
+
+		py_mem_current = arena;
+	}
+
+	if((pool = arena->free)) arena->free = pool->next;
+	else {
+		pool = (void*) (arena->pools + arena->carved++ * PY_MEM_POOL);
+		pool->arena = arena;
+	}
+
+	arena->used++;
+
+	return pool;
+}
+
+/* Gives an empty pool back to its arena, and the arena back if unused. */
+static void py_mem_pool_delete(struct py_mem_pool* pool) {
+	struct py_mem_arena* arena = pool->arena;
+
+	pool->size = 0;
+	pool->next = arena->free;
+	arena->free = pool;
+
+	if(--arena->used) {
+		if(!py_mem_current || py_mem_arena_full(py_mem_current)) {
+			py_mem_current = arena;
+		}
+	}
+	else if(arena != py_mem_current) py_mem_arena_delete(arena);
+}
+
+static void py_mem_link(struct py_mem_pool* pool, unsigned index) {
+	pool->prev = 0;
+	pool->next = py_mem_usable[index];
+	if(pool->next) pool->next->prev = pool;
+	py_mem_usable[index] = pool;
+}
+
+static void py_mem_unlink(struct py_mem_pool* pool, unsigned index) {
+	if(pool->prev) pool->prev->next = pool->next;
+	else py_mem_usable[index] = pool->next;
+
+	if(pool->next) pool->next->prev = pool->prev;
+}
+
+static int py_mem_pool_full(struct py_mem_pool* pool) {
+	return !pool->free && pool->top + pool->size > PY_MEM_POOL;
+}
+
+void* py_mem_alloc(size_t size) {
+	struct py_mem_pool* pool;
+	unsigned index;
+	void* block;
+
+	if(size > PY_MEM_MAX) {
+#ifdef PY_REF_DEBUG
+		py_mem_large++;
+#endif
+		return malloc(size);
+	}
+
+	index = size ? (unsigned) ((size - 1) / PY_MEM_ALIGN) : 0;
+
+	if(!(pool = py_mem_usable[index])) {
+		if(!(pool = py_mem_pool_new())) return 0;
+
+		pool->free = 0;
+		pool->size = (index + 1) * PY_MEM_ALIGN;
+		pool->used = 0;
+		pool->top = PY_MEM_HEADER;
+
+		py_mem_link(pool, index);
+	}
+
+#ifdef PY_REF_DEBUG
+	py_mem_pooled++;
+	if(pool->free) py_mem_reused++;
+#endif
+
+	if((block = pool->free)) pool->free = *(void**) block;
+	else {
+		block = (char*) pool + pool->top;
+		pool->top += pool->size;
+	}
+
+	pool->used++;
+
+	if(py_mem_pool_full(pool)) py_mem_unlink(pool, index);
+
+	return block;
+}
+
+void py_mem_free(void* p, size_t size) {
+	struct py_mem_pool* pool;
+	unsigned index;
+
+	if(!p) return;
+
+	if(size > PY_MEM_MAX) {
+		free(p);
+		return;
+	}
+
+	pool = PY_MEM_POOL_OF(p);
+	index = pool->size / PY_MEM_ALIGN - 1;
+
+	if(py_mem_pool_full(pool)) py_mem_link(pool, index);
+
+	*(void**) p = pool->free;
+	pool->free = p;
+
+	if(!--pool->used) {
+		py_mem_unlink(pool, index);
+		py_mem_pool_delete(pool);
+	}
+}
+
+#ifdef PY_REF_DEBUG
+/*
+ * Reports how often requests were served from pools, and for each arena how
+ * much of the space in its pools in use is taken by live blocks -- the rest
+ * being lost to fragmentation.
+ */
+void py_mem_print_stats(FILE* fp) {
+	struct py_mem_arena* arena;
+	unsigned long total = py_mem_pooled + py_mem_large;
+
+	fprintf(
+			fp, "Pooled %lu of %lu requests (%.1f%%), %lu reusing a block\n",
+			py_mem_pooled, total,
+			total ? 100.0 * (double) py_mem_pooled / (double) total : 0.0,
+			py_mem_reused);
+
+	for(arena = py_mem_arenas; arena; arena = arena->next) {
+		unsigned long live = 0;
+		unsigned long space = arena->used * (PY_MEM_POOL - PY_MEM_HEADER);
+		unsigned i;
+
+		for(i = 0; i < arena->carved; i++) {
+			struct py_mem_pool* pool = (void*) (arena->pools + i * PY_MEM_POOL);
+
+			if(pool->size) live += pool->used * pool->size;
+		}
+
+		fprintf(
+				fp, "Arena %p: %u/%u pools, %.1f%% fragmented\n",
+				(void*) arena, arena->used, PY_MEM_POOLS,
+				space ? 100.0 - 100.0 * (double) live / (double) space : 0.0);
+	}
+}
+#endif
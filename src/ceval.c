@@ -14,11 +14,13 @@
 #include <python/compile.h>
 #include <python/ceval.h>
 #include <python/errors.h>
+#include <python/gc.h>
 
 #include <python/module/builtin.h>
 
 #include <python/object/frame.h>
 #include <python/object/int.h>
+#include <python/object/float.h>
 #include <python/object/dict.h>
 #include <python/object/string.h>
 #include <python/object/list.h>
@@ -37,6 +39,146 @@ enum py_ceval_why {
 	PY_WHY_BREAK /* 'break' statement */
 };
 
+/*
+ * Instruction dispatch.
+ *
+ * With the "labels as values" extension every handler jumps straight to the
+ * handler of the next instruction through a per-opcode label table, rather
+ * than going back to the top of the loop and through the switch. Each
+ * handler then ends in its own indirect branch, which the branch predictor
+ * can learn separately. Handlers which cannot fail also skip the shared
+ * `why' check. Define `PY_NO_COMPUTED_GOTO' to build the portable switch
+ * only.
+ */
+
+#if defined(__GNUC__) && !defined(PY_NO_COMPUTED_GOTO)
+# define PY_COMPUTED_GOTO
+#endif
+
+#define PY_FETCH() \
+	do { \
+		py_code_unit_t unit = *next++; \
+		opcode = PY_CODE_OP(unit); \
+		oparg = (int) PY_CODE_ARG(unit); \
+	} while(0)
+
+#ifdef PY_COMPUTED_GOTO
+# define PY_TARGET(op) case op: py_target_##op
+# define PY_DISPATCH() \
+	do { \
+		PY_FETCH(); \
+		goto *py_opcode_targets[opcode]; \
+	} while(0)
+#else
+# define PY_TARGET(op) case op
+# define PY_DISPATCH() continue
+#endif
+
+/* Go on to the next instruction unless the handler set `why'. */
+#define PY_NEXT() if(why == PY_WHY_NOT) PY_DISPATCH(); break
+
+/*
+ * Instruction quickening.
+ *
+ * The generic arithmetic and comparison handlers rewrite their own opcode to
+ * a type-specialised form once they see a pair of ints or a pair of floats.
+ * The specialised handlers only check their guard and operate on the values
+ * directly. When the guard fails they rewrite the instruction back to its
+ * generic form and take the generic path, so a site whose operand types
+ * change settles on whatever it has seen most recently.
+ */
+
+/* Rewrite the opcode of the instruction being executed to `op'. */
+#define PY_QUICKEN(op) \
+	(next[-1] = PY_CODE_UNIT(op, PY_CODE_ARG(next[-1])))
+
+/* Quicken the current instruction by the types of `v' and `w'. */
+#define PY_QUICKEN_BINARY(int_op, float_op) \
+	do { \
+		if(PY_TYPE(v) == PY_TYPE(w)) { \
+			if(PY_TYPE(v) == PY_TYPE_INT) PY_QUICKEN(int_op); \
+			else if(PY_TYPE(v) == PY_TYPE_FLOAT) PY_QUICKEN(float_op); \
+		} \
+	} while(0)
+
+#ifdef PY_TAGGED_INT
+# define PY_INT_VALUE(op) \
+		(PY_IS_TAGGED(op) ? PY_INT_UNTAG(op) : ((struct py_int*) (op))->value)
+#else
+# define PY_INT_VALUE(op) (((struct py_int*) (op))->value)
+#endif
+#define PY_FLOAT_VALUE(op) (((struct py_float*) (op))->value)
+
+/*
+ * Body of a specialised `v op w' over operands of type `kind'. Falls back to
+ * the generic handler at `generic' with the operands still on the stack.
+ */
+#define PY_BINARY_SPECIALISED(kind, value, new, op, generic_op, generic) \
+	do { \
+		w = stack_pointer[-1]; \
+		v = stack_pointer[-2]; \
+		if(PY_TYPE(v) != (kind) || PY_TYPE(w) != (kind)) { \
+			PY_QUICKEN(generic_op); \
+			goto generic; \
+		} \
+		--stack_pointer; \
+		if(!(stack_pointer[-1] = new(value(v) op value(w)))) { \
+			py_error_set_nomem(); \
+			why = PY_WHY_EXCEPTION; \
+		} \
+		py_object_decref(v); \
+		py_object_decref(w); \
+	} while(0)
+
+/*
+ * As above for floats, but reusing an operand for the result where the stack
+ * holds the only reference to it -- an intermediate result, as in the first
+ * addition of `a*b + c*d + e'. That way a chain of float arithmetic boxes a
+ * new value only for the temporaries it can't overwrite.
+ */
+#define PY_BINARY_FLOAT(op, generic_op, generic) \
+	do { \
+		w = stack_pointer[-1]; \
+		v = stack_pointer[-2]; \
+		if(PY_TYPE(v) != PY_TYPE_FLOAT || PY_TYPE(w) != PY_TYPE_FLOAT) { \
+			PY_QUICKEN(generic_op); \
+			goto generic; \
+		} \
+		--stack_pointer; \
+		if(v->refcount == 1) { \
+			PY_FLOAT_VALUE(v) = PY_FLOAT_VALUE(v) op PY_FLOAT_VALUE(w); \
+			py_object_decref(w); \
+		} \
+		else if(w->refcount == 1) { \
+			PY_FLOAT_VALUE(w) = PY_FLOAT_VALUE(v) op PY_FLOAT_VALUE(w); \
+			stack_pointer[-1] = w; \
+			py_object_decref(v); \
+		} \
+		else { \
+			x = py_float_new(PY_FLOAT_VALUE(v) op PY_FLOAT_VALUE(w)); \
+			if(!(stack_pointer[-1] = x)) { \
+				py_error_set_nomem(); \
+				why = PY_WHY_EXCEPTION; \
+			} \
+			py_object_decref(v); \
+			py_object_decref(w); \
+		} \
+	} while(0)
+
+/* Apply the ordering comparison `op' to the three-way result `cmp'. */
+static int py_cmp_test(enum py_cmp_op op, int cmp) {
+	switch(op) {
+		default: return 0;
+
+		case PY_CMP_LT: return cmp < 0;
+		case PY_CMP_LE: return cmp <= 0;
+		case PY_CMP_EQ: return cmp == 0;
+		case PY_CMP_NE: return cmp != 0;
+		case PY_CMP_GT: return cmp > 0;
+		case PY_CMP_GE: return cmp >= 0;
+	}
+}
+
 static const char* py_code_get_name(struct py_frame* f, unsigned i) {
 	return py_string_get(py_list_get(f->code->names, i));
 }
@@ -47,14 +189,13 @@ struct py_object* py_code_eval(
 		struct py_env* env, struct py_code* co, struct py_object* globals,
 		struct py_object* locals, struct py_object* args) {
 
-	py_byte_t* code;
-	py_byte_t* next;
+	py_code_unit_t* code;
+	py_code_unit_t* next;
 
 	py_byte_t opcode; /* Current opcode */
 	int oparg = 0; /* Current opcode argument, if any */
 
 	struct py_object** stack_pointer;
-	unsigned lineno = UINT_MAX; /* Current line number */
 
 	struct py_object* x = PY_NONE; /* Result object -- NULL if error */
 	struct py_object* v; /* Temporary objects popped off stack */
@@ -62,15 +203,120 @@ struct py_object* py_code_eval(
 	struct py_object* u;
 
 	struct py_frame* f; /* Current frame */
+	struct py_dict* builtins; /* Builtins dict, for LOAD_NAME */
 
 	struct py_object* retval = 0; /* Return value if why == PY_WHY_RETURN */
 	enum py_ceval_why why = PY_WHY_NOT; /* Reason for block stack unwind */
 	int err; /* Error status -- nonzero if error */
 
+#ifdef PY_COMPUTED_GOTO
+# ifdef __GNUC__
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Woverride-init"
+# endif
+	static void* const py_opcode_targets[256] = {
+			[0 ... 255] = &&py_target_unknown,
+
+			[PY_OP_POP_TOP] = &&py_target_PY_OP_POP_TOP,
+			[PY_OP_ROT_TWO] = &&py_target_PY_OP_ROT_TWO,
+			[PY_OP_ROT_THREE] = &&py_target_PY_OP_ROT_THREE,
+			[PY_OP_DUP_TOP] = &&py_target_PY_OP_DUP_TOP,
+
+			[PY_OP_UNARY_NEGATIVE] = &&py_target_PY_OP_UNARY_NEGATIVE,
+			[PY_OP_UNARY_NOT] = &&py_target_PY_OP_UNARY_NOT,
+			[PY_OP_UNARY_CALL] = &&py_target_PY_OP_UNARY_CALL,
+
+			[PY_OP_BINARY_MULTIPLY] = &&py_target_PY_OP_BINARY_MULTIPLY,
+			[PY_OP_BINARY_DIVIDE] = &&py_target_PY_OP_BINARY_DIVIDE,
+			[PY_OP_BINARY_MODULO] = &&py_target_PY_OP_BINARY_MODULO,
+			[PY_OP_BINARY_ADD] = &&py_target_PY_OP_BINARY_ADD,
+			[PY_OP_BINARY_SUBTRACT] = &&py_target_PY_OP_BINARY_SUBTRACT,
+			[PY_OP_BINARY_SUBSCR] = &&py_target_PY_OP_BINARY_SUBSCR,
+			[PY_OP_BINARY_CALL] = &&py_target_PY_OP_BINARY_CALL,
+			[PY_OP_LOOP_CALL] = &&py_target_PY_OP_LOOP_CALL,
+
+			[PY_OP_BINARY_MULTIPLY_INT] =
+				&&py_target_PY_OP_BINARY_MULTIPLY_INT,
+			[PY_OP_BINARY_MULTIPLY_FLOAT] =
+				&&py_target_PY_OP_BINARY_MULTIPLY_FLOAT,
+			[PY_OP_BINARY_ADD_INT] = &&py_target_PY_OP_BINARY_ADD_INT,
+			[PY_OP_BINARY_ADD_FLOAT] = &&py_target_PY_OP_BINARY_ADD_FLOAT,
+			[PY_OP_BINARY_SUBTRACT_INT] =
+				&&py_target_PY_OP_BINARY_SUBTRACT_INT,
+			[PY_OP_BINARY_SUBTRACT_FLOAT] =
+				&&py_target_PY_OP_BINARY_SUBTRACT_FLOAT,
+
+			[PY_OP_SLICE + 0] = &&py_target_PY_OP_SLICE,
+			[PY_OP_SLICE + 1] = &&py_target_PY_OP_SLICE,
+			[PY_OP_SLICE + 2] = &&py_target_PY_OP_SLICE,
+			[PY_OP_SLICE + 3] = &&py_target_PY_OP_SLICE,
+
+			[PY_OP_STORE_SUBSCR] = &&py_target_PY_OP_STORE_SUBSCR,
+
+			[PY_OP_PRINT_EXPR] = &&py_target_PY_OP_PRINT_EXPR,
+
+			[PY_OP_BREAK_LOOP] = &&py_target_PY_OP_BREAK_LOOP,
+			[PY_OP_LOAD_LOCALS] = &&py_target_PY_OP_LOAD_LOCALS,
+			[PY_OP_RETURN_VALUE] = &&py_target_PY_OP_RETURN_VALUE,
+			[PY_OP_REQUIRE_ARGS] = &&py_target_PY_OP_REQUIRE_ARGS,
+			[PY_OP_REFUSE_ARGS] = &&py_target_PY_OP_REFUSE_ARGS,
+			[PY_OP_BUILD_FUNCTION] = &&py_target_PY_OP_BUILD_FUNCTION,
+			[PY_OP_POP_BLOCK] = &&py_target_PY_OP_POP_BLOCK,
+			[PY_OP_BUILD_CLASS] = &&py_target_PY_OP_BUILD_CLASS,
+
+			[PY_OP_STORE_NAME] = &&py_target_PY_OP_STORE_NAME,
+			[PY_OP_UNPACK_TUPLE] = &&py_target_PY_OP_UNPACK_TUPLE,
+			[PY_OP_UNPACK_LIST] = &&py_target_PY_OP_UNPACK_LIST,
+
+			[PY_OP_STORE_ATTR] = &&py_target_PY_OP_STORE_ATTR,
+
+			[PY_OP_LOAD_CONST] = &&py_target_PY_OP_LOAD_CONST,
+			[PY_OP_LOAD_NAME] = &&py_target_PY_OP_LOAD_NAME,
+			[PY_OP_BUILD_TUPLE] = &&py_target_PY_OP_BUILD_TUPLE,
+			[PY_OP_BUILD_LIST] = &&py_target_PY_OP_BUILD_LIST,
+			[PY_OP_BUILD_MAP] = &&py_target_PY_OP_BUILD_MAP,
+			[PY_OP_LOAD_ATTR] = &&py_target_PY_OP_LOAD_ATTR,
+			[PY_OP_COMPARE_OP] = &&py_target_PY_OP_COMPARE_OP,
+			[PY_OP_IMPORT_NAME] = &&py_target_PY_OP_IMPORT_NAME,
+			[PY_OP_IMPORT_FROM] = &&py_target_PY_OP_IMPORT_FROM,
+
+			[PY_OP_JUMP_FORWARD] = &&py_target_PY_OP_JUMP_FORWARD,
+			[PY_OP_JUMP_IF_FALSE] = &&py_target_PY_OP_JUMP_IF_FALSE,
+			[PY_OP_JUMP_IF_TRUE] = &&py_target_PY_OP_JUMP_IF_TRUE,
+			[PY_OP_JUMP_ABSOLUTE] = &&py_target_PY_OP_JUMP_ABSOLUTE,
+			[PY_OP_FOR_LOOP] = &&py_target_PY_OP_FOR_LOOP,
+
+			[PY_OP_COMPARE_INT] = &&py_target_PY_OP_COMPARE_INT,
+			[PY_OP_COMPARE_FLOAT] = &&py_target_PY_OP_COMPARE_FLOAT,
+
+			[PY_OP_SETUP_LOOP] = &&py_target_PY_OP_SETUP_LOOP,
+			[PY_OP_SETUP_EXCEPT] = &&py_target_PY_OP_SETUP_EXCEPT,
+
+			[PY_OP_LOAD_FAST] = &&py_target_PY_OP_LOAD_FAST,
+			[PY_OP_STORE_FAST] = &&py_target_PY_OP_STORE_FAST
+	};
+# ifdef __GNUC__
+#  pragma GCC diagnostic pop
+# endif
+#endif
+
 	apro_stamp_start(APRO_CEVAL_CODE_EVAL_RISING);
 
-	/* TODO: Why are these constants the random defaults. */
-	if(!(f = py_frame_new(env->current, co, globals, locals, 50, 20))) {
+	/* A call is as good a place as any for a due collection. */
+	PY_GC_POLL();
+
+	if(!co->cache) {
+		unsigned n = py_varobject_size(co->names);
+
+		if(!(co->cache = calloc(n ? n : 1, sizeof(struct py_name_cache)))) {
+			py_error_set_nomem();
+			return 0;
+		}
+	}
+
+	f = py_frame_new(
+			env->current, co, globals, locals, co->stacksize, co->blocksize);
+	if(!f) {
 		py_error_set_nomem();
 		return 0;
 	}
@@ -79,6 +325,7 @@ struct py_object* py_code_eval(
 	code = f->code->code;
 	next = code;
 	stack_pointer = f->valuestack;
+	builtins = (struct py_dict*) py_builtin_get_dict();
 
 	if(py_object_incref(args)) *stack_pointer++ = args;
 
@@ -89,11 +336,7 @@ struct py_object* py_code_eval(
 	for(;;) {
 		/* Extract opcode and argument */
 
-		opcode = *next++;
-		if(opcode >= PY_OP_HAVE_ARGUMENT) {
-			next += 2;
-			oparg = (next[-1] << 8) + next[-2];
-		}
+		PY_FETCH();
 
 		/* Main switch on opcode */
 
@@ -105,22 +348,22 @@ struct py_object* py_code_eval(
 			 * and that no operation that succeeds does this!
 			 */
 
-			case PY_OP_POP_TOP: {
+			PY_TARGET(PY_OP_POP_TOP): {
 				py_object_decref(*--stack_pointer);
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_ROT_TWO: {
+			PY_TARGET(PY_OP_ROT_TWO): {
 				v = *--stack_pointer;
 				w = *--stack_pointer;
 
 				*stack_pointer++ = v;
 				*stack_pointer++ = w;
 
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_ROT_THREE: {
+			PY_TARGET(PY_OP_ROT_THREE): {
 				v = *--stack_pointer;
 				w = *--stack_pointer;
 				x = *--stack_pointer;
@@ -129,18 +372,18 @@ struct py_object* py_code_eval(
 				*stack_pointer++ = x;
 				*stack_pointer++ = w;
 
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_DUP_TOP: {
+			PY_TARGET(PY_OP_DUP_TOP): {
 				v = py_object_incref(stack_pointer[-1]);
 
 				*stack_pointer++ = v;
 
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_UNARY_NEGATIVE: {
+			PY_TARGET(PY_OP_UNARY_NEGATIVE): {
 				v = *--stack_pointer;
 
 				if(!(*stack_pointer++ = py_object_neg(v))) {
@@ -150,10 +393,10 @@ struct py_object* py_code_eval(
 
 				py_object_decref(v);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_UNARY_NOT: {
+			PY_TARGET(PY_OP_UNARY_NOT): {
 				v = *--stack_pointer;
 
 				if(!(*stack_pointer++ = py_object_not(v))) {
@@ -163,10 +406,10 @@ struct py_object* py_code_eval(
 
 				py_object_decref(v);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BUILD_CLASS: {
+			PY_TARGET(PY_OP_BUILD_CLASS): {
 				v = *--stack_pointer;
 
 				if(!(*stack_pointer++ = py_class_new(v))) {
@@ -176,10 +419,10 @@ struct py_object* py_code_eval(
 
 				py_object_decref(v);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_UNARY_CALL: {
+			PY_TARGET(PY_OP_UNARY_CALL): {
 				v = *--stack_pointer;
 
 				if(!(*stack_pointer++ = py_call_function(env, v, 0))) {
@@ -189,13 +432,17 @@ struct py_object* py_code_eval(
 
 				py_object_decref(v);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BINARY_MULTIPLY: {
+			PY_TARGET(PY_OP_BINARY_MULTIPLY): {
+				py_generic_multiply:
 				w = *--stack_pointer;
 				v = *--stack_pointer;
 
+				PY_QUICKEN_BINARY(
+						PY_OP_BINARY_MULTIPLY_INT, PY_OP_BINARY_MULTIPLY_FLOAT);
+
 				if(!(*stack_pointer++ = py_object_mul(v, w))) {
 					py_error_set_evalop();
 					why = PY_WHY_EXCEPTION;
@@ -204,10 +451,10 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(w);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BINARY_DIVIDE: {
+			PY_TARGET(PY_OP_BINARY_DIVIDE): {
 				w = *--stack_pointer;
 				v = *--stack_pointer;
 
@@ -219,10 +466,10 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(w);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BINARY_MODULO: {
+			PY_TARGET(PY_OP_BINARY_MODULO): {
 				w = *--stack_pointer;
 				v = *--stack_pointer;
 
@@ -234,13 +481,17 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(w);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BINARY_ADD: {
+			PY_TARGET(PY_OP_BINARY_ADD): {
+				py_generic_add:
 				w = *--stack_pointer;
 				v = *--stack_pointer;
 
+				PY_QUICKEN_BINARY(
+						PY_OP_BINARY_ADD_INT, PY_OP_BINARY_ADD_FLOAT);
+
 				if(!(*stack_pointer++ = py_object_add(v, w))) {
 					py_error_set_badcall();
 					why = PY_WHY_EXCEPTION;
@@ -249,13 +500,17 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(w);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BINARY_SUBTRACT: {
+			PY_TARGET(PY_OP_BINARY_SUBTRACT): {
+				py_generic_subtract:
 				w = *--stack_pointer;
 				v = *--stack_pointer;
 
+				PY_QUICKEN_BINARY(
+						PY_OP_BINARY_SUBTRACT_INT, PY_OP_BINARY_SUBTRACT_FLOAT);
+
 				if(!(*stack_pointer++ = py_object_sub(v, w))) {
 					py_error_set_badcall();
 					why = PY_WHY_EXCEPTION;
@@ -264,10 +519,10 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(w);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BINARY_SUBSCR: {
+			PY_TARGET(PY_OP_BINARY_SUBSCR): {
 				w = *--stack_pointer;
 				v = *--stack_pointer;
 
@@ -279,10 +534,10 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(w);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BINARY_CALL: {
+			PY_TARGET(PY_OP_BINARY_CALL): {
 				w = *--stack_pointer;
 				v = *--stack_pointer;
 
@@ -294,16 +549,77 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(w);
 
-				break;
+				PY_NEXT();
+			}
+
+			/* The loop only indexes the sequence, so `range' needn't list it. */
+			PY_TARGET(PY_OP_LOOP_CALL): {
+				w = *--stack_pointer;
+				v = *--stack_pointer;
+
+				if(py_builtin_is_range(v)) x = py_builtin_range_lazy(w);
+				else x = py_call_function(env, v, w);
+
+				if(!(*stack_pointer++ = x)) {
+					if(!py_error_occurred()) py_error_set_evalop();
+					why = PY_WHY_EXCEPTION;
+				}
+
+				py_object_decref(v);
+				py_object_decref(w);
+
+				PY_NEXT();
+			}
+
+			PY_TARGET(PY_OP_BINARY_MULTIPLY_INT): {
+				PY_BINARY_SPECIALISED(
+						PY_TYPE_INT, PY_INT_VALUE, py_int_new, *,
+						PY_OP_BINARY_MULTIPLY, py_generic_multiply);
+
+				PY_NEXT();
+			}
+
+			PY_TARGET(PY_OP_BINARY_MULTIPLY_FLOAT): {
+				PY_BINARY_FLOAT(*, PY_OP_BINARY_MULTIPLY, py_generic_multiply);
+
+				PY_NEXT();
+			}
+
+			PY_TARGET(PY_OP_BINARY_ADD_INT): {
+				PY_BINARY_SPECIALISED(
+						PY_TYPE_INT, PY_INT_VALUE, py_int_new, +,
+						PY_OP_BINARY_ADD, py_generic_add);
+
+				PY_NEXT();
+			}
+
+			PY_TARGET(PY_OP_BINARY_ADD_FLOAT): {
+				PY_BINARY_FLOAT(+, PY_OP_BINARY_ADD, py_generic_add);
+
+				PY_NEXT();
+			}
+
+			PY_TARGET(PY_OP_BINARY_SUBTRACT_INT): {
+				PY_BINARY_SPECIALISED(
+						PY_TYPE_INT, PY_INT_VALUE, py_int_new, -,
+						PY_OP_BINARY_SUBTRACT, py_generic_subtract);
+
+				PY_NEXT();
+			}
+
+			PY_TARGET(PY_OP_BINARY_SUBTRACT_FLOAT): {
+				PY_BINARY_FLOAT(-, PY_OP_BINARY_SUBTRACT, py_generic_subtract);
+
+				PY_NEXT();
 			}
 
-			case PY_OP_SLICE + 0:; PY_FALLTHROUGH;
-			/* FALLTHROUGH */
 			case PY_OP_SLICE + 1:; PY_FALLTHROUGH;
 			/* FALLTHROUGH */
 			case PY_OP_SLICE + 2:; PY_FALLTHROUGH;
 			/* FALLTHROUGH */
-			case PY_OP_SLICE + 3: {
+			case PY_OP_SLICE + 3:; PY_FALLTHROUGH;
+			/* FALLTHROUGH */
+			PY_TARGET(PY_OP_SLICE): {
 				if((opcode - PY_OP_SLICE) & 2) w = *--stack_pointer;
 				else w = 0;
 
@@ -321,10 +637,10 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(w);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_STORE_SUBSCR: {
+			PY_TARGET(PY_OP_STORE_SUBSCR): {
 				w = *--stack_pointer;
 				v = *--stack_pointer;
 				u = *--stack_pointer;
@@ -338,62 +654,62 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(w);
 
-				break;
+				PY_NEXT();
 			}
 
 			/* TODO: De-printify opcodes. */
-			case PY_OP_PRINT_EXPR: {
+			PY_TARGET(PY_OP_PRINT_EXPR): {
 				py_object_decref(*--stack_pointer);
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_BREAK_LOOP: {
+			PY_TARGET(PY_OP_BREAK_LOOP): {
 				why = PY_WHY_BREAK;
 				break;
 			}
 
-			case PY_OP_LOAD_LOCALS: {
+			PY_TARGET(PY_OP_LOAD_LOCALS): {
 				*stack_pointer++ = py_object_incref(f->locals);
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_RETURN_VALUE: {
+			PY_TARGET(PY_OP_RETURN_VALUE): {
 				retval = *--stack_pointer;
 				why = PY_WHY_RETURN;
 				break;
 			}
 
 			/* TODO: Should these be a concern? Seems legacy. */
-			case PY_OP_REQUIRE_ARGS: {
+			PY_TARGET(PY_OP_REQUIRE_ARGS): {
 				if(!(stack_pointer - f->valuestack)) {
 					py_error_set_string(
 							py_type_error, "function expects argument(s)");
 					why = PY_WHY_EXCEPTION;
 				}
 
-				break;
+				PY_NEXT();
 			}
-			case PY_OP_REFUSE_ARGS: {
+			PY_TARGET(PY_OP_REFUSE_ARGS): {
 				if((stack_pointer - f->valuestack)) {
 					py_error_set_string(
 							py_type_error, "function expects no argument(s)");
 					why = PY_WHY_EXCEPTION;
 				}
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BUILD_FUNCTION: {
+			PY_TARGET(PY_OP_BUILD_FUNCTION): {
 				v = *--stack_pointer;
 
 				*stack_pointer++ = py_func_new(v, f->globals);
 
 				py_object_decref(v);
 
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_POP_BLOCK: {
+			PY_TARGET(PY_OP_POP_BLOCK): {
 				struct py_block* b;
 
 				if(!f->iblock) {
@@ -408,13 +724,15 @@ struct py_object* py_code_eval(
 					py_object_decref(*--stack_pointer);
 				}
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_STORE_NAME: {
+			PY_TARGET(PY_OP_STORE_NAME): {
 				v = *--stack_pointer;
 
-				err = py_dict_insert(f->locals, py_code_get_name(f, oparg), v);
+				w = py_list_get(f->code->names, oparg);
+
+				err = py_dict_assign(f->locals, w, v);
 				if(err == -1) {
 					py_error_set_evalop();
 					why = PY_WHY_EXCEPTION;
@@ -422,13 +740,13 @@ struct py_object* py_code_eval(
 
 				py_object_decref(v);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_UNPACK_TUPLE: {
+			PY_TARGET(PY_OP_UNPACK_TUPLE): {
 				v = *--stack_pointer;
 
-				if(v->type != PY_TYPE_TUPLE) {
+				if(PY_TYPE(v) != PY_TYPE_TUPLE) {
 					py_error_set_string(py_type_error, "unpack non-tuple");
 					why = PY_WHY_EXCEPTION;
 				}
@@ -446,14 +764,14 @@ struct py_object* py_code_eval(
 
 				py_object_decref(v);
 
-				break;
+				PY_NEXT();
 			}
 
 			/* TODO: Consolidate list/tuple since they do the same thing? */
-			case PY_OP_UNPACK_LIST: {
+			PY_TARGET(PY_OP_UNPACK_LIST): {
 				v = *--stack_pointer;
 
-				if(v->type != PY_TYPE_LIST) {
+				if(PY_TYPE(v) != PY_TYPE_LIST) {
 					py_error_set_string(py_type_error, "unpack non-list");
 					why = PY_WHY_EXCEPTION;
 					break;
@@ -473,14 +791,16 @@ struct py_object* py_code_eval(
 
 				py_object_decref(v);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_STORE_ATTR: {
+			PY_TARGET(PY_OP_STORE_ATTR): {
 				v = *--stack_pointer;
 				u = *--stack_pointer;
 
-				err = py_object_set_attr(v, py_code_get_name(f, oparg), u);
+				w = py_list_get(f->code->names, oparg);
+
+				err = py_object_set_attr(v, w, u);
 				if(err == -1) {
 					py_error_set_evalop();
 					why = PY_WHY_EXCEPTION;
@@ -489,32 +809,84 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(u);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_LOAD_CONST: {
+			PY_TARGET(PY_OP_LOAD_CONST): {
 				x = py_object_incref(py_list_get(f->code->consts, oparg));
 				*stack_pointer++ = x;
-				break;
+				PY_DISPATCH();
+			}
+
+			PY_TARGET(PY_OP_STORE_FAST): {
+				x = f->fastlocals[oparg];
+				f->fastlocals[oparg] = *--stack_pointer;
+
+				py_object_decref(x);
+
+				PY_DISPATCH();
 			}
 
-			case PY_OP_LOAD_NAME: {
-				const char* name = py_code_get_name(f, oparg);
+			PY_TARGET(PY_OP_LOAD_FAST): {
+				if((x = f->fastlocals[oparg])) {
+					*stack_pointer++ = py_object_incref(x);
+
+					PY_DISPATCH();
+				}
 
-				if(!(x = py_dict_lookup(f->locals, name))) {
-					if(!(x = py_dict_lookup(f->globals, name))) {
-						x = py_builtin_get(name);
+				/* Never stored to, so not a local -- look further afield. */
+				PY_FALLTHROUGH;
+			}
+			/* FALLTHROUGH */
+			PY_TARGET(PY_OP_LOAD_NAME): {
+				struct py_name_cache* cache = &f->code->cache[oparg];
+				struct py_dict* locals = (struct py_dict*) f->locals;
+				struct py_dict* globals = (struct py_dict*) f->globals;
+				unsigned long version = 0;
+				struct py_dictentry* ep = 0;
+
+				/* Slot frames may hold a snapshot dict which is not consulted */
+				if(f->fastlocals) locals = 0;
+				else version = locals->version;
+
+				if(cache->locals == version &&
+					cache->globals == globals->version &&
+					cache->builtins == builtins->version) {
+
+					x = cache->entry->value;
+					*stack_pointer++ = py_object_incref(x);
+
+					PY_DISPATCH();
+				}
+
+				w = py_list_get(f->code->names, oparg);
+
+				if(locals) ep = py_dict_lookup_entry((void*) locals, w);
+				if(!ep) {
+					if(!(ep = py_dict_lookup_entry(f->globals, w))) {
+						ep = py_dict_lookup_entry((void*) builtins, w);
 					}
 				}
 
-				if(!x) py_error_set_string(py_name_error, name);
+				if(ep) {
+					cache->locals = version;
+					cache->globals = globals->version;
+					cache->builtins = builtins->version;
+					cache->entry = ep;
+
+					x = ep->value;
+				}
+				else {
+					py_error_set_string(py_name_error, py_string_get(w));
+					x = 0;
+				}
 
 				*stack_pointer++ = py_object_incref(x);
 
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_BUILD_TUPLE: {
+			PY_TARGET(PY_OP_BUILD_TUPLE): {
 				if(!(x = py_tuple_new(oparg))) {
 					py_error_set_nomem();
 					why = PY_WHY_EXCEPTION;
@@ -525,10 +897,10 @@ struct py_object* py_code_eval(
 
 				*stack_pointer++ = x;
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BUILD_LIST: {
+			PY_TARGET(PY_OP_BUILD_LIST): {
 				if(!(x = py_list_new(oparg))) {
 					py_error_set_nomem();
 					why = PY_WHY_EXCEPTION;
@@ -539,33 +911,40 @@ struct py_object* py_code_eval(
 
 				*stack_pointer++ = x;
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_BUILD_MAP: {
-				if(!(*stack_pointer++ = py_dict_new())) {
+			PY_TARGET(PY_OP_BUILD_MAP): {
+				if(!(*stack_pointer++ = py_dict_new_sized((unsigned) oparg))) {
 					py_error_set_nomem();
 					why = PY_WHY_EXCEPTION;
 				}
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_LOAD_ATTR: {
+			PY_TARGET(PY_OP_LOAD_ATTR): {
 				v = *--stack_pointer;
 
-				x = py_object_get_attr(v, py_code_get_name(f, oparg));
+				w = py_list_get(f->code->names, oparg);
+
+				x = py_object_get_attr(v, w);
 				*stack_pointer++ = x;
 
 				py_object_decref(v);
 
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_COMPARE_OP: {
+			PY_TARGET(PY_OP_COMPARE_OP): {
+				py_generic_compare:
 				w = *--stack_pointer;
 				v = *--stack_pointer;
 
+				if(oparg <= PY_CMP_GE) {
+					PY_QUICKEN_BINARY(PY_OP_COMPARE_INT, PY_OP_COMPARE_FLOAT);
+				}
+
 				if(!(*stack_pointer++ = py_cmp_outcome(oparg, v, w))) {
 					py_error_set_evalop();
 					why = PY_WHY_EXCEPTION;
@@ -574,10 +953,63 @@ struct py_object* py_code_eval(
 				py_object_decref(v);
 				py_object_decref(w);
 
-				break;
+				PY_NEXT();
+			}
+
+			PY_TARGET(PY_OP_COMPARE_INT): {
+				py_value_t i, j;
+
+				w = stack_pointer[-1];
+				v = stack_pointer[-2];
+
+				if(PY_TYPE(v) != PY_TYPE_INT || PY_TYPE(w) != PY_TYPE_INT) {
+					PY_QUICKEN(PY_OP_COMPARE_OP);
+					goto py_generic_compare;
+				}
+
+				i = PY_INT_VALUE(v);
+				j = PY_INT_VALUE(w);
+
+				x = py_cmp_test(oparg, (i < j) ? -1 : (i > j)) ?
+					PY_TRUE : PY_FALSE;
+
+				--stack_pointer;
+				stack_pointer[-1] = py_object_incref(x);
+
+				py_object_decref(v);
+				py_object_decref(w);
+
+				PY_DISPATCH();
+			}
+
+			PY_TARGET(PY_OP_COMPARE_FLOAT): {
+				double i, j;
+
+				w = stack_pointer[-1];
+				v = stack_pointer[-2];
+
+				if(PY_TYPE(v) != PY_TYPE_FLOAT || PY_TYPE(w) != PY_TYPE_FLOAT) {
+					PY_QUICKEN(PY_OP_COMPARE_OP);
+					goto py_generic_compare;
+				}
+
+				i = PY_FLOAT_VALUE(v);
+				j = PY_FLOAT_VALUE(w);
+
+				/* Same three-way result as `py_float_cmp' -- NaN included. */
+				x = py_cmp_test(oparg, (i < j) ? -1 : (i > j)) ?
+					PY_TRUE : PY_FALSE;
+
+				--stack_pointer;
+				stack_pointer[-1] = py_object_incref(x);
+
+				py_object_decref(v);
+				py_object_decref(w);
+
+				PY_DISPATCH();
 			}
 
-			case PY_OP_IMPORT_NAME: {
+			PY_TARGET(PY_OP_IMPORT_NAME): {
 				if(!(v = py_import_module(env, py_code_get_name(f, oparg)))) {
 					py_error_set_evalop();
 					why = PY_WHY_EXCEPTION;
@@ -585,10 +1017,10 @@ struct py_object* py_code_eval(
 
 				*stack_pointer++ = py_object_incref(v);
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_IMPORT_FROM: {
+			PY_TARGET(PY_OP_IMPORT_FROM): {
 				v = stack_pointer[-1];
 
 				err = py_import_from(f->locals, v, py_code_get_name(f, oparg));
@@ -597,40 +1029,43 @@ struct py_object* py_code_eval(
 					why = PY_WHY_EXCEPTION;
 				}
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_JUMP_FORWARD: {
+			PY_TARGET(PY_OP_JUMP_FORWARD): {
 				next += oparg;
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_JUMP_IF_FALSE: {
+			PY_TARGET(PY_OP_JUMP_IF_FALSE): {
 				if(!py_object_truthy(stack_pointer[-1])) next += oparg;
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_JUMP_IF_TRUE: {
+			PY_TARGET(PY_OP_JUMP_IF_TRUE): {
 				if(py_object_truthy(stack_pointer[-1])) next += oparg;
-				break;
+				PY_DISPATCH();
 			}
 
-			case PY_OP_JUMP_ABSOLUTE: {
+			PY_TARGET(PY_OP_JUMP_ABSOLUTE): {
 				next = code + oparg;
-				break;
+				PY_GC_POLL();
+				PY_DISPATCH();
 			}
 
-			case PY_OP_FOR_LOOP: {
+			PY_TARGET(PY_OP_FOR_LOOP): {
 				/*
 				 * for v in s: ...
-				 * On entry: stack contains s, i.
-				 * On exit: stack contains s, i+1, s[i];
+				 * On entry: stack contains s.
+				 * On exit: stack contains s, s[i];
 				 * but if loop exhausted:
-				 * s, i are popped, and we jump
+				 * s is popped, and we jump
+				 * The index i is kept in the loop's block, which is
+				 * innermost whenever control is back at the loop head.
 				 */
+				struct py_block* b = &f->blockstack[f->iblock - 1];
 
-				w = *--stack_pointer; /* Loop index */
-				v = *--stack_pointer; /* Sequence struct py_object*/
+				v = stack_pointer[-1]; /* Sequence struct py_object*/
 
 				if (!py_is_varobject(v)) {
 					py_error_set_string(
@@ -640,30 +1075,27 @@ struct py_object* py_code_eval(
 					break;
 				}
 
-				if (!(u = py_loop_subscript(v, w))) {
-					py_object_decref(v);
-					py_object_decref(w);
+				if (!(u = py_loop_subscript(v, b->index))) {
+					if(py_error_occurred()) {
+						why = PY_WHY_EXCEPTION;
+						break;
+					}
+
+					py_object_decref(*--stack_pointer);
 
 					next += oparg;
 					break;
 				}
 
-				if (!(x = py_int_new(py_int_get(w) + 1))) {
-					py_error_set_nomem();
-					why = PY_WHY_EXCEPTION;
-				}
-
-				*stack_pointer++ = v;
-				*stack_pointer++ = x;
-				py_object_decref(w);
+				b->index++;
 				*stack_pointer++ = u;
 
-				break;
+				PY_NEXT();
 			}
 
-			case PY_OP_SETUP_LOOP:; PY_FALLTHROUGH;
+			PY_TARGET(PY_OP_SETUP_LOOP):; PY_FALLTHROUGH;
 			/* FALLTHROUGH */
-			case PY_OP_SETUP_EXCEPT: {
+			PY_TARGET(PY_OP_SETUP_EXCEPT): {
 				if(f->iblock >= f->nblocks) {
 					py_error_set_string(py_runtime_error, "stack overflow");
 					why = PY_WHY_EXCEPTION;
@@ -674,14 +1106,13 @@ struct py_object* py_code_eval(
 						f, opcode, (unsigned) (next - code) + oparg,
 						(unsigned) (stack_pointer - f->valuestack));
 
-				break;
-			}
-
-			case PY_OP_SET_LINENO: {
-				lineno = oparg;
-				break;
+				PY_NEXT();
 			}
 
+#ifdef PY_COMPUTED_GOTO
+			py_target_unknown:; PY_FALLTHROUGH;
+			/* FALLTHROUGH */
+#endif
 			default: {
 				py_error_set_string(
 						py_system_error, "py_code_eval: unknown opcode");
@@ -706,7 +1137,10 @@ struct py_object* py_code_eval(
 #endif
 
 		/* Log traceback info if this is a real exception */
-		if(why == PY_WHY_EXCEPTION) py_traceback_new(f, lineno);
+		if(why == PY_WHY_EXCEPTION) {
+			/* The failed instruction is the one before `next'. */
+			py_traceback_new(f, (unsigned) (next - code) - 1);
+		}
 
 		/* Unwind stacks if a (pseudo) exception occurred */
 		while(f->iblock > 0) {
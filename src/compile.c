@@ -7,7 +7,6 @@
 
 /*
  * XXX TO DO:
- * XXX Compute maximum needed stack sizes while compiling
  * XXX Generate simple jump for break/return outside 'try...finally'
  * XXX Include function name in code (and module names?)
  */
@@ -26,31 +25,47 @@
 #include <python/object/string.h>
 
 #define PY_CODE_CHUNK (1024)
+#define PY_LINES_CHUNK (256)
 
 /* Data structure used internally */
 struct py_compiler {
 	unsigned len;
 	unsigned offset; /* index into code */
-	py_byte_t* code;
+	py_code_unit_t* code;
 
 	struct py_object* consts; /* list of objects */
 	struct py_object* names; /* list of strings (names) */
 
 	const char* filename; /* filename of current node */
 
+	py_byte_t* lines; /* line number table */
+	unsigned lines_len;
+	unsigned lines_offset; /* index into lines */
+	unsigned last_line; /* line and code offset of the last table entry */
+	unsigned last_offset;
+
 	unsigned in_function; /* set when compiling a function */
+	unsigned fast; /* set when names are bound in frame slots */
 	unsigned nesting; /* counts nested loops */
 };
 
 static struct py_code* py_code_new(
-		py_byte_t* code, struct py_object* consts,
-		struct py_object* names, const char* filename) {
+		py_code_unit_t* code, py_byte_t* lines, unsigned nlines,
+		struct py_object* consts, struct py_object* names,
+		const char* filename, int fast, unsigned stacksize,
+		unsigned blocksize) {
 
 	struct py_code* co;
 
 	if(!(co = py_object_new(PY_TYPE_CODE))) return 0;
 
 	co->code = code;
+	co->lines = lines;
+	co->nlines = nlines;
+	co->cache = 0;
+	co->fast = fast;
+	co->stacksize = stacksize;
+	co->blocksize = blocksize;
 	co->consts = py_object_incref(consts);
 	co->names = py_object_incref(names);
 
@@ -75,7 +90,13 @@ static int py_compiler_new(struct py_compiler* c, const char* filename) {
 	}
 
 	c->offset = 0;
+	c->lines = 0;
+	c->lines_len = 0;
+	c->lines_offset = 0;
+	c->last_line = 0;
+	c->last_offset = 0;
 	c->in_function = 0;
+	c->fast = 0;
 	c->nesting = 0;
 	c->filename = filename;
 
@@ -87,9 +108,12 @@ static void py_compiler_delete(struct py_compiler* c) {
 	py_object_decref(c->names);
 }
 
-static void py_compile_add_byte(struct py_compiler* c, py_byte_t byte) {
+static void py_compile_add_op_arg(
+		struct py_compiler* c, py_byte_t op, unsigned arg) {
+
 	if(c->offset >= c->len) {
-		void* newptr = realloc(c->code, c->len + PY_CODE_CHUNK);
+		size_t size = (c->len + PY_CODE_CHUNK) * sizeof(py_code_unit_t);
+		void* newptr = realloc(c->code, size);
 		if(!newptr) {
 			free(c->code);
 			/* TODO: Better nomem handling */
@@ -97,52 +121,107 @@ static void py_compile_add_byte(struct py_compiler* c, py_byte_t byte) {
 		}
 
 		c->code = newptr;
-		memset(c->code + c->len, 0, PY_CODE_CHUNK);
 		c->len += PY_CODE_CHUNK;
 	}
 
-	c->code[c->offset++] = byte;
+	if(arg > PY_CODE_ARG_MAX) {
+		py_error_set_string(py_system_error, "instruction argument too big");
+		/* TODO: Proper EH. */
+		abort();
+	}
+
+	c->code[c->offset++] = PY_CODE_UNIT(op, arg);
 }
 
-static void py_compile_add_int(struct py_compiler* c, unsigned x) {
-	py_compile_add_byte(c, (py_byte_t) (x & 0xFF));
-	py_compile_add_byte(c, (py_byte_t) (x >> 8));
+static void py_compile_add_op(struct py_compiler* c, py_byte_t op) {
+	py_compile_add_op_arg(c, op, 0);
 }
 
-static void py_compile_add_op_arg(
-		struct py_compiler* c, py_byte_t op, unsigned arg) {
+#ifndef PY_STRIP_LINENO
+static void py_compile_add_line_byte(struct py_compiler* c, py_byte_t byte) {
+	if(c->lines_offset >= c->lines_len) {
+		void* newptr = realloc(c->lines, c->lines_len + PY_LINES_CHUNK);
+		if(!newptr) {
+			free(c->lines);
+			/* TODO: Better nomem handling */
+			abort();
+		}
+
+		c->lines = newptr;
+		c->lines_len += PY_LINES_CHUNK;
+	}
 
-	py_compile_add_byte(c, op);
-	py_compile_add_int(c, arg);
+	c->lines[c->lines_offset++] = byte;
 }
+#endif
 
-/* Compile a forward reference for backpatching */
+/*
+ * The line number table is a series of byte pairs: how far the code offset
+ * advances (unsigned) and how far the line moves (signed) from one entry to
+ * the next, starting from offset 0 at line 0. Steps too big for a byte are
+ * split over several pairs. The code carries no line tracking instructions
+ * of its own -- the table is only read when a traceback is made.
+ */
+static void py_compile_set_lineno(struct py_compiler* c, unsigned line) {
+#ifdef PY_STRIP_LINENO
+	(void) c;
+	(void) line;
+#else
+	unsigned addr = c->offset - c->last_offset;
+	long delta = (long) line - (long) c->last_line;
+
+	if(!delta) return;
+
+	for(; addr > 255; addr -= 255) {
+		py_compile_add_line_byte(c, 255);
+		py_compile_add_line_byte(c, 0);
+	}
+
+	for(; delta > 127; delta -= 127) {
+		py_compile_add_line_byte(c, (py_byte_t) addr);
+		py_compile_add_line_byte(c, 127);
+		addr = 0;
+	}
+
+	for(; delta < -128; delta += 128) {
+		py_compile_add_line_byte(c, (py_byte_t) addr);
+		py_compile_add_line_byte(c, (py_byte_t) -128);
+		addr = 0;
+	}
+
+	py_compile_add_line_byte(c, (py_byte_t) addr);
+	py_compile_add_line_byte(c, (py_byte_t) (signed char) delta);
+
+	c->last_line = line;
+	c->last_offset = c->offset;
+#endif
+}
+
+/*
+ * Compile a forward reference for backpatching. Anchors are the offset just
+ * past the referring instruction, and chain through their arguments until
+ * patched.
+ */
 static void py_compile_add_forward_reference(
 		struct py_compiler* c, py_byte_t op, unsigned* p_anchor) {
 
-	unsigned anchor;
+	unsigned anchor = *p_anchor;
 
-	py_compile_add_byte(c, op);
+	py_compile_add_op_arg(c, op, anchor == 0 ? 0 : c->offset + 1 - anchor);
 
-	anchor = *p_anchor;
 	*p_anchor = c->offset;
-
-	py_compile_add_int(c, anchor == 0 ? 0 : c->offset - anchor);
 }
 
 static void py_compile_backpatch(struct py_compiler* c, unsigned anchor) {
 	unsigned target = c->offset;
 	unsigned prev;
-	int dist;
 
 	for(;;) {
-		/* Make the JUMP instruction at anchor point to target */
-		prev = c->code[anchor] + (c->code[anchor + 1] << 8);
+		/* Make the JUMP instruction before anchor point to target */
+		py_code_unit_t* unit = &c->code[anchor - 1];
 
-		dist = (int) (target - (anchor + 2));
-
-		c->code[anchor] = (py_byte_t) (dist & 0xFF);
-		c->code[anchor + 1] = (py_byte_t) (dist >> 8);
+		prev = PY_CODE_ARG(*unit);
+		*unit = PY_CODE_UNIT(PY_CODE_OP(*unit), target - anchor);
 
 		if(!prev) break;
 		anchor -= prev;
@@ -185,7 +264,7 @@ static void py_compile_add_op_name(
 		name = n->str;
 	}
 
-	if(!(v = py_string_new(name))) {
+	if(!(v = py_string_intern(name))) {
 		/* TODO: Proper EH. */
 		abort();
 	}
@@ -194,6 +273,17 @@ static void py_compile_add_op_name(
 		py_object_decref(v);
 	}
 
+	/*
+	 * Every name gets a slot, the slot number being its index in the name
+	 * list. A slot which was never stored to is not a local, so LOAD_FAST
+	 * goes on to globals and builtins -- the same outcome as a miss in a
+	 * fresh locals dict.
+	 */
+	if(c->fast) {
+		if(op == PY_OP_LOAD_NAME) op = PY_OP_LOAD_FAST;
+		else if(op == PY_OP_STORE_NAME) op = PY_OP_STORE_FAST;
+	}
+
 	py_compile_add_op_arg(c, op, i);
 }
 
@@ -317,7 +407,12 @@ static void py_compile_atom(struct py_compiler* c, struct py_node* n) {
 		}
 
 		case PY_STRING: {
-			if((v = py_compile_parse_string(ch->str)) == NULL) {
+			/*
+			 * Interned like names, so that a string constant used as a dict
+			 * key is found by pointer.
+			 */
+			v = py_compile_parse_string(ch->str);
+			if(v == NULL || py_string_intern_object(&v) == -1) {
 				/* TODO: Proper EH. */
 				abort();
 			}
@@ -353,25 +448,25 @@ static void py_compile_apply_subscript(struct py_compiler* c, struct py_node* n)
 	if(n->count == 1 && n->children[0].type != PY_COLON) {
 		/* It's a single PY_GRAMMAR_SUBSCRIPT */
 		py_compile_node(c, &n->children[0]);
-		py_compile_add_byte(c, PY_OP_BINARY_SUBSCR);
+		py_compile_add_op(c, PY_OP_BINARY_SUBSCR);
 	}
 	else {
 		/* It's a slice: [PY_GRAMMAR_EXPRESSION] ':' [PY_GRAMMAR_EXPRESSION] */
-		if(n->count == 1) py_compile_add_byte(c, PY_OP_SLICE);
+		if(n->count == 1) py_compile_add_op(c, PY_OP_SLICE);
 		else if(n->count == 2) {
 			if(n->children[0].type != PY_COLON) {
 				py_compile_node(c, &n->children[0]);
-				py_compile_add_byte(c, PY_OP_SLICE + 1);
+				py_compile_add_op(c, PY_OP_SLICE + 1);
 			}
 			else {
 				py_compile_node(c, &n->children[1]);
-				py_compile_add_byte(c, PY_OP_SLICE + 2);
+				py_compile_add_op(c, PY_OP_SLICE + 2);
 			}
 		}
 		else {
 			py_compile_node(c, &n->children[0]);
 			py_compile_node(c, &n->children[2]);
-			py_compile_add_byte(c, PY_OP_SLICE + 3);
+			py_compile_add_op(c, PY_OP_SLICE + 3);
 		}
 	}
 }
@@ -386,11 +481,11 @@ static void com_apply_trailer(struct py_compiler* c, struct py_node* n) {
 	switch(n->children[0].type) {
 		case PY_LPAR: {
 			if(n->children[1].type == PY_RPAR) {
-				py_compile_add_byte(c, PY_OP_UNARY_CALL);
+				py_compile_add_op(c, PY_OP_UNARY_CALL);
 			}
 			else {
 				py_compile_node(c, &n->children[1]);
-				py_compile_add_byte(c, PY_OP_BINARY_CALL);
+				py_compile_add_op(c, PY_OP_BINARY_CALL);
 			}
 
 			break;
@@ -425,7 +520,7 @@ static void py_compile_factor(struct py_compiler* c, struct py_node* n) {
 
 	if(n->children[0].type == PY_MINUS) {
 		py_compile_factor(c, &n->children[1]);
-		py_compile_add_byte(c, PY_OP_UNARY_NEGATIVE);
+		py_compile_add_op(c, PY_OP_UNARY_NEGATIVE);
 	}
 	else {
 		py_compile_atom(c, &n->children[0]);
@@ -472,7 +567,7 @@ static void py_compile_term(struct py_compiler* c, struct py_node* n) {
 			}
 		}
 
-		py_compile_add_byte(c, op);
+		py_compile_add_op(c, op);
 	}
 }
 
@@ -509,7 +604,7 @@ static void py_compile_expression(struct py_compiler* c, struct py_node* n) {
 			}
 		}
 
-		py_compile_add_byte(c, op);
+		py_compile_add_op(c, op);
 	}
 }
 
@@ -609,8 +704,8 @@ static void py_compile_comparison(struct py_compiler* c, struct py_node* n) {
 		py_compile_expression(c, &n->children[i]);
 
 		if(i + 2 < n->count) {
-			py_compile_add_byte(c, PY_OP_DUP_TOP);
-			py_compile_add_byte(c, PY_OP_ROT_THREE);
+			py_compile_add_op(c, PY_OP_DUP_TOP);
+			py_compile_add_op(c, PY_OP_ROT_THREE);
 		}
 
 		op = py_compile_compare_type(&n->children[i - 1]);
@@ -624,7 +719,7 @@ static void py_compile_comparison(struct py_compiler* c, struct py_node* n) {
 		py_compile_add_op_arg(c, PY_OP_COMPARE_OP, op);
 		if(i + 2 < n->count) {
 			py_compile_add_forward_reference(c, PY_OP_JUMP_IF_FALSE, &anchor);
-			py_compile_add_byte(c, PY_OP_POP_TOP);
+			py_compile_add_op(c, PY_OP_POP_TOP);
 		}
 	}
 
@@ -633,8 +728,8 @@ static void py_compile_comparison(struct py_compiler* c, struct py_node* n) {
 
 		py_compile_add_forward_reference(c, PY_OP_JUMP_FORWARD, &anchor2);
 		py_compile_backpatch(c, anchor);
-		py_compile_add_byte(c, PY_OP_ROT_TWO);
-		py_compile_add_byte(c, PY_OP_POP_TOP);
+		py_compile_add_op(c, PY_OP_ROT_TWO);
+		py_compile_add_op(c, PY_OP_POP_TOP);
 		py_compile_backpatch(c, anchor2);
 	}
 }
@@ -646,7 +741,7 @@ static void py_compile_test_not(struct py_compiler* c, struct py_node* n) {
 	if(n->count == 1) py_compile_comparison(c, &n->children[0]);
 	else {
 		py_compile_test_not(c, &n->children[1]);
-		py_compile_add_byte(c, PY_OP_UNARY_NOT);
+		py_compile_add_op(c, PY_OP_UNARY_NOT);
 	}
 }
 
@@ -662,7 +757,7 @@ static void py_compile_test_and(struct py_compiler* c, struct py_node* n) {
 		if((i += 2) >= n->count) break;
 
 		py_compile_add_forward_reference(c, PY_OP_JUMP_IF_FALSE, &anchor);
-		py_compile_add_byte(c, PY_OP_POP_TOP);
+		py_compile_add_op(c, PY_OP_POP_TOP);
 	}
 
 	if(anchor) py_compile_backpatch(c, anchor);
@@ -681,7 +776,7 @@ static void py_compile_test(struct py_compiler* c, struct py_node* n) {
 		if((i += 2) >= n->count) break;
 
 		py_compile_add_forward_reference(c, PY_OP_JUMP_IF_TRUE, &anchor);
-		py_compile_add_byte(c, PY_OP_POP_TOP);
+		py_compile_add_op(c, PY_OP_POP_TOP);
 	}
 
 	if(anchor) py_compile_backpatch(c, anchor);
@@ -733,7 +828,7 @@ static void py_compile_assign_trailer(
 			PY_REQ(n, PY_GRAMMAR_SUBSCRIPT); /* PY_GRAMMAR_SUBSCRIPT: PY_GRAMMAR_EXPRESSION | [PY_GRAMMAR_EXPRESSION] ':' [PY_GRAMMAR_EXPRESSION] */
 
 			py_compile_node(c, &n->children[0]);
-			py_compile_add_byte(c, PY_OP_STORE_SUBSCR);
+			py_compile_add_op(c, PY_OP_STORE_SUBSCR);
 
 			break;
 		}
@@ -947,11 +1042,11 @@ static void py_compile_expression_stmt(
 	PY_REQ(n, PY_GRAMMAR_EXPRESSION_STATEMENT);
 
 	py_compile_node(c, &n->children[n->count - 2]);
-	if(n->count == 2) py_compile_add_byte(c, PY_OP_PRINT_EXPR);
+	if(n->count == 2) py_compile_add_op(c, PY_OP_PRINT_EXPR);
 	else {
 		unsigned i;
 		for(i = 0; i < n->count - 3; i += 2) {
-			if(i + 2 < n->count - 3) py_compile_add_byte(c, PY_OP_DUP_TOP);
+			if(i + 2 < n->count - 3) py_compile_add_op(c, PY_OP_DUP_TOP);
 			py_compile_assign(c, &n->children[i]);
 		}
 	}
@@ -975,7 +1070,7 @@ static void py_compile_return_statement(
 	}
 	else py_compile_node(c, &n->children[1]);
 
-	py_compile_add_byte(c, PY_OP_RETURN_VALUE);
+	py_compile_add_op(c, PY_OP_RETURN_VALUE);
 }
 
 static void py_compile_import_statement(
@@ -999,7 +1094,7 @@ static void py_compile_import_statement(
 			py_compile_add_op_name(c, PY_OP_IMPORT_FROM, &n->children[i]);
 		}
 
-		py_compile_add_byte(c, PY_OP_POP_TOP);
+		py_compile_add_op(c, PY_OP_POP_TOP);
 	}
 	else {
 		/* 'import' ... */
@@ -1025,16 +1120,16 @@ static void py_compile_if_statement(struct py_compiler* c, struct py_node* n) {
 		unsigned a = 0;
 		struct py_node* ch = &n->children[i + 1];
 
-		if(i > 0) py_compile_add_op_arg(c, PY_OP_SET_LINENO, ch->lineno);
+		if(i > 0) py_compile_set_lineno(c, ch->lineno);
 
 		py_compile_node(c, &n->children[i + 1]);
 		py_compile_add_forward_reference(c, PY_OP_JUMP_IF_FALSE, &a);
-		py_compile_add_byte(c, PY_OP_POP_TOP);
+		py_compile_add_op(c, PY_OP_POP_TOP);
 
 		py_compile_node(c, &n->children[i + 3]);
 		py_compile_add_forward_reference(c, PY_OP_JUMP_FORWARD, &anchor);
 		py_compile_backpatch(c, a);
-		py_compile_add_byte(c, PY_OP_POP_TOP);
+		py_compile_add_op(c, PY_OP_POP_TOP);
 	}
 
 	if(i + 2 < n->count) py_compile_node(c, &n->children[i + 2]);
@@ -1059,10 +1154,10 @@ static void py_compile_while_statement(
 
 	begin = c->offset;
 
-	py_compile_add_op_arg(c, PY_OP_SET_LINENO, n->lineno);
+	py_compile_set_lineno(c, n->lineno);
 	py_compile_node(c, &n->children[1]);
 	py_compile_add_forward_reference(c, PY_OP_JUMP_IF_FALSE, &anchor);
-	py_compile_add_byte(c, PY_OP_POP_TOP);
+	py_compile_add_op(c, PY_OP_POP_TOP);
 
 	c->nesting++;
 	py_compile_node(c, &n->children[3]);
@@ -1070,8 +1165,8 @@ static void py_compile_while_statement(
 
 	py_compile_add_op_arg(c, PY_OP_JUMP_ABSOLUTE, begin);
 	py_compile_backpatch(c, anchor);
-	py_compile_add_byte(c, PY_OP_POP_TOP);
-	py_compile_add_byte(c, PY_OP_POP_BLOCK);
+	py_compile_add_op(c, PY_OP_POP_TOP);
+	py_compile_add_op(c, PY_OP_POP_BLOCK);
 
 	if(n->count > 4) py_compile_node(c, &n->children[6]);
 
@@ -1081,7 +1176,6 @@ static void py_compile_while_statement(
 static void py_compile_for_statement(
 		struct py_compiler* c, struct py_node* n) {
 
-	struct py_object* v;
 	unsigned break_anchor = 0;
 	unsigned anchor = 0;
 	unsigned begin;
@@ -1095,18 +1189,17 @@ static void py_compile_for_statement(
 	py_compile_add_forward_reference(c, PY_OP_SETUP_LOOP, &break_anchor);
 	py_compile_node(c, &n->children[3]);
 
-	v = py_int_new(0);
-	if(v == NULL) {
-		/* TODO: Proper EH. */
-		abort();
+	/*
+	 * A sequence made by a call -- `range(n)', most often -- is only seen by
+	 * the loop, so the call can give something other than a list.
+	 */
+	if(PY_CODE_OP(c->code[c->offset - 1]) == PY_OP_BINARY_CALL) {
+		c->code[c->offset - 1] = PY_CODE_UNIT(PY_OP_LOOP_CALL, 0);
 	}
 
-	py_compile_add_op_arg(c, PY_OP_LOAD_CONST, py_compile_add_const(c, v));
-	py_object_decref(v);
-
 	begin = c->offset;
 
-	py_compile_add_op_arg(c, PY_OP_SET_LINENO, n->lineno);
+	py_compile_set_lineno(c, n->lineno);
 	py_compile_add_forward_reference(c, PY_OP_FOR_LOOP, &anchor);
 	py_compile_assign(c, &n->children[1]);
 
@@ -1116,7 +1209,7 @@ static void py_compile_for_statement(
 
 	py_compile_add_op_arg(c, PY_OP_JUMP_ABSOLUTE, begin);
 	py_compile_backpatch(c, anchor);
-	py_compile_add_byte(c, PY_OP_POP_BLOCK);
+	py_compile_add_op(c, PY_OP_POP_BLOCK);
 
 	if(n->count > 8) py_compile_node(c, &n->children[8]);
 
@@ -1232,7 +1325,7 @@ static void py_compile_try_statement(
 		unsigned i;
 		struct py_node* ch;
 
-		py_compile_add_byte(c, PY_OP_POP_BLOCK);
+		py_compile_add_op(c, PY_OP_POP_BLOCK);
 		py_compile_add_forward_reference(c, PY_OP_JUMP_FORWARD, &end_anchor);
 		py_compile_backpatch(c, except_anchor);
 
@@ -1253,29 +1346,29 @@ static void py_compile_try_statement(
 			}
 
 			except_anchor = 0;
-			py_compile_add_op_arg(c, PY_OP_SET_LINENO, ch->lineno);
+			py_compile_set_lineno(c, ch->lineno);
 
 			if(ch->count > 1) {
-				py_compile_add_byte(c, PY_OP_DUP_TOP);
+				py_compile_add_op(c, PY_OP_DUP_TOP);
 				py_compile_node(c, &ch->children[1]);
 				py_compile_add_op_arg(c, PY_OP_COMPARE_OP, PY_CMP_EXC_MATCH);
 				py_compile_add_forward_reference(
 						c, PY_OP_JUMP_IF_FALSE, &except_anchor);
-				py_compile_add_byte(c, PY_OP_POP_TOP);
+				py_compile_add_op(c, PY_OP_POP_TOP);
 			}
 
-			py_compile_add_byte(c, PY_OP_POP_TOP);
+			py_compile_add_op(c, PY_OP_POP_TOP);
 
 			if(ch->count > 3) py_compile_assign(c, &ch->children[3]);
-			else py_compile_add_byte(c, PY_OP_POP_TOP);
+			else py_compile_add_op(c, PY_OP_POP_TOP);
 
-			py_compile_add_byte(c, PY_OP_POP_TOP);
+			py_compile_add_op(c, PY_OP_POP_TOP);
 			py_compile_node(c, &n->children[i + 2]);
 			py_compile_add_forward_reference(c, PY_OP_JUMP_FORWARD, &end_anchor);
 
 			if(except_anchor) {
 				py_compile_backpatch(c, except_anchor);
-				py_compile_add_byte(c, PY_OP_POP_TOP);
+				py_compile_add_op(c, PY_OP_POP_TOP);
 			}
 		}
 
@@ -1320,7 +1413,7 @@ static void py_compile_function_definition(
 	}
 	else {
 		py_compile_add_op_arg(c, PY_OP_LOAD_CONST, py_compile_add_const(c, v));
-		py_compile_add_byte(c, PY_OP_BUILD_FUNCTION);
+		py_compile_add_op(c, PY_OP_BUILD_FUNCTION);
 		py_compile_add_op_name(c, PY_OP_STORE_NAME, &n->children[1]);
 		py_object_decref(v);
 	}
@@ -1353,9 +1446,9 @@ static void py_compile_class_definition(
 	}
 	else {
 		py_compile_add_op_arg(c, PY_OP_LOAD_CONST, py_compile_add_const(c, v));
-		py_compile_add_byte(c, PY_OP_BUILD_FUNCTION);
-		py_compile_add_byte(c, PY_OP_UNARY_CALL);
-		py_compile_add_byte(c, PY_OP_BUILD_CLASS);
+		py_compile_add_op(c, PY_OP_BUILD_FUNCTION);
+		py_compile_add_op(c, PY_OP_UNARY_CALL);
+		py_compile_add_op(c, PY_OP_BUILD_CLASS);
 		py_compile_add_op_name(c, PY_OP_STORE_NAME, &n->children[1]);
 		py_object_decref(v);
 	}
@@ -1389,7 +1482,7 @@ static void py_compile_node(struct py_compiler* c, struct py_node* n) {
 		case PY_GRAMMAR_SIMPLE_STATEMENT:; PY_FALLTHROUGH;
 		/* FALLTHROUGH */
 		case PY_GRAMMAR_COMPOUND_STATEMENT: {
-			py_compile_add_op_arg(c, PY_OP_SET_LINENO, n->lineno);
+			py_compile_set_lineno(c, n->lineno);
 			py_compile_node(c, &n->children[0]);
 
 			break;
@@ -1410,7 +1503,7 @@ static void py_compile_node(struct py_compiler* c, struct py_node* n) {
 				abort();
 			}
 
-			py_compile_add_byte(c, PY_OP_BREAK_LOOP);
+			py_compile_add_op(c, PY_OP_BREAK_LOOP);
 
 			break;
 		}
@@ -1581,6 +1674,34 @@ static void py_compile_file_input(struct py_compiler* c, struct py_node* n) {
 	}
 }
 
+/*
+ * Whether the tree at `n' binds names that cannot be known at compile time
+ * -- i.e. has a `from ... import'. Nested definitions are compiled apart so
+ * are not looked into.
+ */
+static int py_compile_has_dynamic_names(struct py_node* n) {
+	unsigned i;
+
+	switch(n->type) {
+		default: break;
+
+		case PY_GRAMMAR_FUNCTION_DEFINITION:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_GRAMMAR_CLASS_DEFINITION: return 0;
+
+		case PY_GRAMMAR_IMPORT_STATEMENT: {
+			if(n->children[0].str[0] == 'f') return 1;
+			break;
+		}
+	}
+
+	for(i = 0; i < n->count; i++) {
+		if(py_compile_has_dynamic_names(&n->children[i])) return 1;
+	}
+
+	return 0;
+}
+
 /* Top-level py_compile-node interface */
 
 static void py_compile_function_signature(
@@ -1597,9 +1718,11 @@ static void py_compile_function_signature(
 	ch = &n->children[2]; /* parameters: '(' [PY_GRAMMAR_PARAMETER_LIST] ')' */
 	ch = &ch->children[1]; /* ')' | PY_GRAMMAR_PARAMETER_LIST */
 
-	if(ch->type == PY_RPAR) py_compile_add_byte(c, PY_OP_REFUSE_ARGS);
+	c->fast = !py_compile_has_dynamic_names(&n->children[4]);
+
+	if(ch->type == PY_RPAR) py_compile_add_op(c, PY_OP_REFUSE_ARGS);
 	else {
-		py_compile_add_byte(c, PY_OP_REQUIRE_ARGS);
+		py_compile_add_op(c, PY_OP_REQUIRE_ARGS);
 		py_compile_parameter_list(c, ch);
 	}
 
@@ -1609,21 +1732,21 @@ static void py_compile_function_signature(
 
 	py_compile_add_op_arg(
 			c, PY_OP_LOAD_CONST, py_compile_add_const(c, PY_NONE));
-	py_compile_add_byte(c, PY_OP_RETURN_VALUE);
+	py_compile_add_op(c, PY_OP_RETURN_VALUE);
 }
 
 /* TODO: Rename. */
 static void compile_node(struct py_compiler* c, struct py_node* n) {
-	py_compile_add_op_arg(c, PY_OP_SET_LINENO, n->lineno);
+	py_compile_set_lineno(c, n->lineno);
 
 	switch(n->type) {
 		/* A whole file. */
 		case PY_GRAMMAR_FILE_INPUT: {
-			py_compile_add_byte(c, PY_OP_REFUSE_ARGS);
+			py_compile_add_op(c, PY_OP_REFUSE_ARGS);
 			py_compile_file_input(c, n);
 			py_compile_add_op_arg(
 					c, PY_OP_LOAD_CONST, py_compile_add_const(c, PY_NONE));
-			py_compile_add_byte(c, PY_OP_RETURN_VALUE);
+			py_compile_add_op(c, PY_OP_RETURN_VALUE);
 
 			break;
 		}
@@ -1640,10 +1763,10 @@ static void compile_node(struct py_compiler* c, struct py_node* n) {
 			 * 'class' PY_NAME parameters
 			 * ['=' PY_GRAMMAR_BASE_LIST] ':' PY_GRAMMAR_SUITE
 			 */
-			py_compile_add_byte(c, PY_OP_REFUSE_ARGS);
+			py_compile_add_op(c, PY_OP_REFUSE_ARGS);
 			py_compile_node(c, &n->children[n->count - 1]);
-			py_compile_add_byte(c, PY_OP_LOAD_LOCALS);
-			py_compile_add_byte(c, PY_OP_RETURN_VALUE);
+			py_compile_add_op(c, PY_OP_LOAD_LOCALS);
+			py_compile_add_op(c, PY_OP_RETURN_VALUE);
 
 			break;
 		}
@@ -1658,33 +1781,266 @@ static void compile_node(struct py_compiler* c, struct py_node* n) {
 	}
 }
 
+/*
+ * Net effect of an instruction on the value stack depth, for those which
+ * fall through to the next instruction.
+ */
+static int py_compile_stack_effect(py_byte_t op, unsigned arg) {
+	switch(op) {
+		default: return 0;
+
+		case PY_OP_POP_TOP:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_PRINT_EXPR:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_BINARY_MULTIPLY:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_BINARY_DIVIDE:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_BINARY_MODULO:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_BINARY_ADD:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_BINARY_SUBTRACT:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_BINARY_SUBSCR:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_BINARY_CALL:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_LOOP_CALL:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_SLICE + 1:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_SLICE + 2:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_STORE_NAME:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_STORE_FAST:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_COMPARE_OP: return -1;
+
+		case PY_OP_SLICE + 3:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_STORE_ATTR: return -2;
+
+		case PY_OP_STORE_SUBSCR: return -3;
+
+		case PY_OP_DUP_TOP:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_LOAD_LOCALS:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_LOAD_CONST:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_LOAD_NAME:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_LOAD_FAST:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_BUILD_MAP:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_IMPORT_NAME: return 1;
+
+		case PY_OP_UNPACK_TUPLE:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_UNPACK_LIST: return (int) arg - 1;
+
+		case PY_OP_BUILD_TUPLE:; PY_FALLTHROUGH;
+		/* FALLTHROUGH */
+		case PY_OP_BUILD_LIST: return 1 - (int) arg;
+
+		/* Pushes s[i]. */
+		case PY_OP_FOR_LOOP: return 1;
+	}
+}
+
+/*
+ * Work out the deepest the value and block stacks get when running `code',
+ * by following every path through it. Code is entered with the argument (if
+ * any) on the stack. Where paths meet they agree on depth -- the compiler
+ * only jumps between points at the same statement nesting -- so each
+ * instruction needs looking at once.
+ */
+static enum py_result py_compile_stack_depth(
+		py_code_unit_t* code, unsigned len, unsigned* stacksize,
+		unsigned* blocksize) {
+
+	struct py_stack_state {
+		unsigned offset;
+		int depth;
+		unsigned blocks;
+	};
+
+	struct py_stack_state* work;
+	unsigned nwork = 0;
+	py_byte_t* seen;
+	int max_depth = 1;
+	unsigned max_blocks = 0;
+
+	if(!(seen = calloc(len + 1, sizeof(py_byte_t)))) return PY_RESULT_OOM;
+	if(!(work = malloc((len + 1) * sizeof(struct py_stack_state)))) {
+		free(seen);
+		return PY_RESULT_OOM;
+	}
+
+#define PY_STACK_PUSH(o, d, b) \
+	do { \
+		if((o) < len && !seen[o]) { \
+			seen[o] = 1; \
+			work[nwork].offset = (o); \
+			work[nwork].depth = (d); \
+			work[nwork].blocks = (b); \
+			nwork++; \
+		} \
+	} while(0)
+
+	PY_STACK_PUSH(0, 1, 0);
+
+	while(nwork) {
+		struct py_stack_state s = work[--nwork];
+
+		for(;;) {
+			py_byte_t op = PY_CODE_OP(code[s.offset]);
+			unsigned arg = PY_CODE_ARG(code[s.offset]);
+
+			s.offset++;
+
+			switch(op) {
+				default: break;
+
+				case PY_OP_BREAK_LOOP:; PY_FALLTHROUGH;
+				/* FALLTHROUGH */
+				case PY_OP_RETURN_VALUE: goto next;
+
+				case PY_OP_REFUSE_ARGS: s.depth = 0; break;
+
+				case PY_OP_JUMP_FORWARD: {
+					s.offset += arg;
+					if(s.offset >= len || seen[s.offset]) goto next;
+					seen[s.offset] = 1;
+					continue;
+				}
+
+				case PY_OP_JUMP_ABSOLUTE: {
+					PY_STACK_PUSH(arg, s.depth, s.blocks);
+					goto next;
+				}
+
+				case PY_OP_JUMP_IF_FALSE:; PY_FALLTHROUGH;
+				/* FALLTHROUGH */
+				case PY_OP_JUMP_IF_TRUE: {
+					PY_STACK_PUSH(s.offset + arg, s.depth, s.blocks);
+					break;
+				}
+
+				/* The sequence is gone once it is exhausted. */
+				case PY_OP_FOR_LOOP: {
+					PY_STACK_PUSH(s.offset + arg, s.depth - 1, s.blocks);
+					break;
+				}
+
+				/* A break resumes at the handler at the setup depth. */
+				case PY_OP_SETUP_LOOP: {
+					PY_STACK_PUSH(s.offset + arg, s.depth, s.blocks);
+					s.blocks++;
+					break;
+				}
+
+				/* Handlers are entered with traceback, value and exception. */
+				case PY_OP_SETUP_EXCEPT: {
+					PY_STACK_PUSH(s.offset + arg, s.depth + 3, s.blocks);
+					if(s.depth + 3 > max_depth) max_depth = s.depth + 3;
+					s.blocks++;
+					break;
+				}
+
+				case PY_OP_POP_BLOCK: {
+					if(s.blocks) s.blocks--;
+					break;
+				}
+			}
+
+			s.depth += py_compile_stack_effect(op, arg);
+
+			if(s.depth > max_depth) max_depth = s.depth;
+			if(s.blocks > max_blocks) max_blocks = s.blocks;
+
+			if(s.offset >= len || seen[s.offset]) break;
+			seen[s.offset] = 1;
+		}
+
+		next:;
+	}
+
+#undef PY_STACK_PUSH
+
+	free(work);
+	free(seen);
+
+	*stacksize = (unsigned) max_depth;
+	*blocksize = max_blocks;
+
+	return PY_RESULT_OK;
+}
+
 struct py_code* py_compile(struct py_node* n, const char* filename) {
 	struct py_compiler sc;
 	struct py_code* co;
+	unsigned stacksize, blocksize;
 	void* newptr;
 
 	if(!py_compiler_new(&sc, filename)) return 0;
 
 	compile_node(&sc, n);
 
-	newptr = realloc(sc.code, sc.offset);
+	newptr = realloc(sc.code, sc.offset * sizeof(py_code_unit_t));
 	if(!newptr) return NULL; /* TODO: Free dead compiler. */
 	sc.code = newptr;
 	sc.len = sc.offset;
 
-	co = py_code_new(sc.code, sc.consts, sc.names, filename);
+	if(py_compile_stack_depth(
+			sc.code, sc.len, &stacksize, &blocksize) != PY_RESULT_OK) {
+
+		py_compiler_delete(&sc);
+		free(sc.code);
+		free(sc.lines);
+		return 0;
+	}
+
+	co = py_code_new(
+			sc.code, sc.lines, sc.lines_offset, sc.consts, sc.names, filename,
+			sc.fast, stacksize, blocksize);
 
 	py_compiler_delete(&sc);
 	return co;
 }
 
+/*
+ * The line that the instruction at `offset' came from, or 0 if the code has
+ * no line information.
+ */
+unsigned py_code_get_line(struct py_code* co, unsigned offset) {
+	unsigned addr = 0;
+	long line = 0;
+	unsigned i;
+
+	for(i = 0; i + 1 < co->nlines; i += 2) {
+		addr += co->lines[i];
+		if(addr > offset) break;
+
+		line += (signed char) co->lines[i + 1];
+	}
+
+	return (unsigned) line;
+}
+
 void py_code_dealloc(struct py_object* op) {
 	struct py_code* co = (struct py_code*) op;
 
 	free(co->code);
+	free(co->lines);
+	free(co->cache);
 	py_object_decref(co->consts);
 	py_object_decref(co->names);
 	py_object_decref(co->filename);
 
-	free(op);
+	py_object_delete(op);
 }
@@ -6,6 +6,7 @@
 #include <python/evalops.h>
 #include <python/env.h>
 #include <python/ceval.h>
+#include <python/compile.h>
 
 #include <python/object/int.h>
 #include <python/object/func.h>
@@ -21,10 +22,10 @@
 
 /* Test a value used as condition, e.g., in a for or if statement */
 int py_object_truthy(struct py_object* v) {
-	if(v->type == PY_TYPE_INT) return py_int_get(v) != 0;
-	else if(v->type == PY_TYPE_FLOAT) return py_float_get(v) != 0.0;
+	if(PY_TYPE(v) == PY_TYPE_INT) return py_int_get(v) != 0;
+	else if(PY_TYPE(v) == PY_TYPE_FLOAT) return py_float_get(v) != 0.0;
 	else if(py_is_varobject(v)) return py_varobject_size(v) != 0;
-	else if(v->type == PY_TYPE_DICT) return ((struct py_dict*) v)->used != 0;
+	else if(PY_TYPE(v) == PY_TYPE_DICT) return ((struct py_dict*) v)->used != 0;
 	else if(v == PY_NONE) return 0;
 
 	/* All other objects are 'true' */
@@ -36,8 +37,8 @@ struct py_object* py_object_not(struct py_object* v) {
 }
 
 struct py_object* py_object_neg(struct py_object* v) {
-	if(v->type == PY_TYPE_INT) return py_int_new(-py_int_get(v));
-	else if(v->type == PY_TYPE_FLOAT) return py_float_new(-py_float_get(v));
+	if(PY_TYPE(v) == PY_TYPE_INT) return py_int_new(-py_int_get(v));
+	else if(PY_TYPE(v) == PY_TYPE_FLOAT) return py_float_new(-py_float_get(v));
 
 	return 0;
 }
@@ -45,13 +46,13 @@ struct py_object* py_object_neg(struct py_object* v) {
 struct py_object* py_object_add(struct py_object* v, struct py_object* w) {
 	py_cat_t cat;
 
-	if(v->type == PY_TYPE_INT && w->type == PY_TYPE_INT) {
+	if(PY_TYPE(v) == PY_TYPE_INT && PY_TYPE(w) == PY_TYPE_INT) {
 		return py_int_new(py_int_get(v) + py_int_get(w));
 	}
-	else if(v->type == PY_TYPE_FLOAT && w->type == PY_TYPE_FLOAT) {
+	else if(PY_TYPE(v) == PY_TYPE_FLOAT && PY_TYPE(w) == PY_TYPE_FLOAT) {
 		return py_float_new(py_float_get(v) + py_float_get(w));
 	}
-	else if((cat = py_types[v->type].cat)) {
+	else if(PY_TYPE(v) == PY_TYPE(w) && (cat = py_types[PY_TYPE(v)].cat)) {
 		return cat(v, w);
 	}
 
@@ -59,10 +60,10 @@ struct py_object* py_object_add(struct py_object* v, struct py_object* w) {
 }
 
 struct py_object* py_object_sub(struct py_object* v, struct py_object* w) {
-	if(v->type == PY_TYPE_INT && w->type == PY_TYPE_INT) {
+	if(PY_TYPE(v) == PY_TYPE_INT && PY_TYPE(w) == PY_TYPE_INT) {
 		return py_int_new(py_int_get(v) - py_int_get(w));
 	}
-	else if(v->type == PY_TYPE_FLOAT && w->type == PY_TYPE_FLOAT) {
+	else if(PY_TYPE(v) == PY_TYPE_FLOAT && PY_TYPE(w) == PY_TYPE_FLOAT) {
 		return py_float_new(py_float_get(v) - py_float_get(w));
 	}
 
@@ -70,10 +71,10 @@ struct py_object* py_object_sub(struct py_object* v, struct py_object* w) {
 }
 
 struct py_object* py_object_mul(struct py_object* v, struct py_object* w) {
-	if(v->type == PY_TYPE_INT && w->type == PY_TYPE_INT) {
+	if(PY_TYPE(v) == PY_TYPE_INT && PY_TYPE(w) == PY_TYPE_INT) {
 		return py_int_new(py_int_get(v) * py_int_get(w));
 	}
-	else if(v->type == PY_TYPE_FLOAT && w->type == PY_TYPE_FLOAT) {
+	else if(PY_TYPE(v) == PY_TYPE_FLOAT && PY_TYPE(w) == PY_TYPE_FLOAT) {
 		return py_float_new(py_float_get(v) * py_float_get(w));
 	}
 
@@ -82,10 +83,10 @@ struct py_object* py_object_mul(struct py_object* v, struct py_object* w) {
 
 
 struct py_object* py_object_div(struct py_object* v, struct py_object* w) {
-	if(v->type == PY_TYPE_INT && w->type == PY_TYPE_INT) {
+	if(PY_TYPE(v) == PY_TYPE_INT && PY_TYPE(w) == PY_TYPE_INT) {
 		return py_int_new(py_int_get(v) / py_int_get(w));
 	}
-	else if(v->type == PY_TYPE_FLOAT && w->type == PY_TYPE_FLOAT) {
+	else if(PY_TYPE(v) == PY_TYPE_FLOAT && PY_TYPE(w) == PY_TYPE_FLOAT) {
 		return py_float_new(py_float_get(v) / py_float_get(w));
 	}
 
@@ -93,10 +94,10 @@ struct py_object* py_object_div(struct py_object* v, struct py_object* w) {
 }
 
 struct py_object* py_object_mod(struct py_object* v, struct py_object* w) {
-	if(v->type == PY_TYPE_INT && w->type == PY_TYPE_INT) {
+	if(PY_TYPE(v) == PY_TYPE_INT && PY_TYPE(w) == PY_TYPE_INT) {
 		return py_int_new(py_int_get(v) % py_int_get(w));
 	}
-	else if(v->type == PY_TYPE_FLOAT && w->type == PY_TYPE_FLOAT) {
+	else if(PY_TYPE(v) == PY_TYPE_FLOAT && PY_TYPE(w) == PY_TYPE_FLOAT) {
 		return py_float_new(fmod(py_float_get(v), py_float_get(w)));
 	}
 
@@ -106,11 +107,11 @@ struct py_object* py_object_mod(struct py_object* v, struct py_object* w) {
 int py_assign_subscript(
 		struct py_object* op, struct py_object* key, struct py_object* value) {
 
-	if(op->type == PY_TYPE_LIST) {
+	if(PY_TYPE(op) == PY_TYPE_LIST) {
 		unsigned i;
 		struct py_list* lp = (void*) op;
 
-		if(key->type != PY_TYPE_INT) return -1;
+		if(PY_TYPE(key) != PY_TYPE_INT) return -1;
 
 		if((i = (unsigned) py_int_get(key)) >= py_varobject_size(op)) {
 			return -1;
@@ -121,11 +122,7 @@ int py_assign_subscript(
 
 		return 0;
 	}
-	else if(op->type == PY_TYPE_DICT) {
-		if(key->type != PY_TYPE_STRING) return -1;
-
-		return py_dict_assign(op, key, value);
-	}
+	else if(PY_TYPE(op) == PY_TYPE_DICT) return py_dict_assign(op, key, value);
 
 	return -1;
 }
@@ -133,12 +130,12 @@ int py_assign_subscript(
 struct py_object* py_object_ind(struct py_object* v, struct py_object* w) {
 	py_ind_t ind;
 
-	if((ind = py_types[v->type].ind)) {
-		if(w->type != PY_TYPE_INT) return 0;
+	if((ind = py_types[PY_TYPE(v)].ind)) {
+		if(PY_TYPE(w) != PY_TYPE_INT) return 0;
 
 		return ind(v, (unsigned) py_int_get(w));
 	}
-	else if(v->type == PY_TYPE_DICT) return py_dict_lookup_object(v, w);
+	else if(PY_TYPE(v) == PY_TYPE_DICT) return py_dict_lookup_object(v, w);
 
 	return 0;
 }
@@ -149,7 +146,7 @@ struct py_object* py_apply_slice(
 	py_slice_t slice;
 	unsigned low, high;
 
-	if(!(slice = py_types[u->type].slice)) return 0;
+	if(!(slice = py_types[PY_TYPE(u)].slice)) return 0;
 
 	low = 0;
 	high = py_varobject_size(u);
@@ -163,20 +160,23 @@ struct py_object* py_apply_slice(
 int py_slice_index(struct py_object* v, unsigned* pi) {
 	if(!v) return 0;
 
-	if(v->type != PY_TYPE_INT) return -1;
+	if(PY_TYPE(v) != PY_TYPE_INT) return -1;
 
 	*pi = (unsigned) py_int_get(v);
 
 	return 0;
 }
 
-struct py_object* py_loop_subscript(struct py_object* v, struct py_object* w) {
-	unsigned i = (unsigned) py_int_get(w);
+/*
+ * Returns item `i' of a sequence being looped over, or NULL with no error set
+ * once it is exhausted. A range makes its item straight from the index.
+ */
+struct py_object* py_loop_subscript(struct py_object* v, unsigned i) {
 	unsigned n = py_varobject_size(v);
 
 	if(i >= n) return 0; /* End of loop */
 
-	return py_types[v->type].ind(v, i);
+	return py_types[PY_TYPE(v)].ind(v, i);
 }
 
 /*
@@ -185,8 +185,10 @@ struct py_object* py_loop_subscript(struct py_object* v, struct py_object* w) {
  * 		 User code should never cause a segfault if our script engine is
  * 		 Doing its job properly.
  */
-struct py_object* py_object_get_attr(struct py_object* v, const char* name) {
-	switch(v->type) {
+struct py_object* py_object_get_attr(
+		struct py_object* v, struct py_object* name) {
+
+	switch(PY_TYPE(v)) {
 		default: return 0;
 
 		case PY_TYPE_CLASS_MEMBER: return py_class_member_get_attr(v, name);
@@ -196,18 +198,17 @@ struct py_object* py_object_get_attr(struct py_object* v, const char* name) {
 }
 
 int py_object_set_attr(
-		struct py_object* v, const char* name, struct py_object* w) {
+		struct py_object* v, struct py_object* name, struct py_object* w) {
 
 	struct py_object* attr;
 
-	if(v->type == PY_TYPE_CLASS_MEMBER) {
+	if(PY_TYPE(v) == PY_TYPE_CLASS_MEMBER) {
 		attr = ((struct py_class_member*) v)->attr;
 	}
-	else if(v->type == PY_TYPE_MODULE) attr = ((struct py_module*) v)->attr;
+	else if(PY_TYPE(v) == PY_TYPE_MODULE) attr = ((struct py_module*) v)->attr;
 	else return -1;
 
-	if(!w) return py_dict_remove(attr, name);
-	else return py_dict_insert(attr, name, w);
+	return py_dict_assign(attr, name, w);
 }
 
 /*
@@ -220,7 +221,7 @@ struct py_object* py_call_function(
 
 	struct py_object* arglist = NULL;
 
-	switch(func->type) {
+	switch(PY_TYPE(func)) {
 		default: return 0;
 
 		case PY_TYPE_METHOD: {
@@ -253,20 +254,27 @@ struct py_object* py_call_function(
 		}
 		/* FALLTHROUGH */
 		case PY_TYPE_FUNC: {
+			struct py_code* code;
 			struct py_object* locals;
 			struct py_object* globals;
 			struct py_object* retval;
 
-			if(!(locals = py_dict_new())) {
+			/*
+			 * Slot locals need no dict. Other code -- a class body, say -- gets
+			 * one with room for every name it uses.
+			 */
+			code = (void*) ((struct py_func*) func)->code;
+			if(code->fast) locals = 0;
+			else if(!(locals = py_dict_new_sized(
+					py_varobject_size(code->names)))) {
+
 				py_object_decref(arglist);
 				return 0;
 			}
 
 			globals = py_object_incref(((struct py_func*) func)->globals);
 
-			retval = py_code_eval(
-					env, (void*) ((struct py_func*) func)->code, globals,
-					locals, args);
+			retval = py_code_eval(env, code, globals, locals, args);
 
 			py_object_decref(locals);
 			py_object_decref(globals);
@@ -278,7 +286,7 @@ struct py_object* py_call_function(
 }
 
 static int py_cmp_exception(struct py_object* err, struct py_object* v) {
-	if(v->type == PY_TYPE_TUPLE) {
+	if(PY_TYPE(v) == PY_TYPE_TUPLE) {
 		unsigned i, n;
 
 		n = py_varobject_size(v);
@@ -296,11 +304,11 @@ static int py_cmp_member(struct py_object* v, struct py_object* w) {
 	int cmp;
 
 	/* Special case for char in string */
-	if(w->type == PY_TYPE_STRING) {
+	if(PY_TYPE(w) == PY_TYPE_STRING) {
 		const char* s;
 		char c;
 
-		if(v->type != PY_TYPE_STRING || py_varobject_size(v) != 1) return -1;
+		if(PY_TYPE(v) != PY_TYPE_STRING || py_varobject_size(v) != 1) return -1;
 
 		c = py_string_get(v)[0];
 		s = py_string_get(w);
@@ -315,7 +323,7 @@ static int py_cmp_member(struct py_object* v, struct py_object* w) {
 	n = py_varobject_size(w);
 
 	for(i = 0; i < n; i++) {
-		x = py_types[w->type].ind(w, i);
+		x = py_types[PY_TYPE(w)].ind(w, i);
 		cmp = py_object_cmp(v, x);
 		py_object_decref(x);
 
@@ -387,6 +395,10 @@ int py_import_from(
 	if(name[0] == '*') {
 		unsigned i;
 
+		if(py_dict_reserve(locals, ((struct py_dict*) w)->used) == -1) {
+			return -1;
+		}
+
 		for(i = 0; i < py_dict_size(w); i++) {
 			name = py_dict_get_key(w, i);
 
@@ -0,0 +1,429 @@
+/*
+ * Copyright 1991 by Stichting Mathematisch Centrum
+ * See `LICENCE' for more information.
+ */
+
+/* Cycle collector implementation */
+
+#include <python/std.h>
+#include <python/gc.h>
+
+#ifdef PY_CYCLE_GC
+/*
+ * A collection works on a list of objects. It first copies each one's
+ * reference count into its header, then takes off one for every reference to
+ * it from inside the list -- what is left are references from elsewhere, and
+ * any object with some is reachable. Objects found reachable from those are
+ * reachable too, and everything else is garbage: it is kept alive while
+ * each object's references are dropped, which frees all of it once let go.
+ */
+
+#define PY_GC_OLDEST (PY_GC_GENERATIONS - 1)
+#define PY_GC_SLICE (256) /* Objects taken per incremental slice */
+
+/* States outside a generation, while being collected or for good. */
+#define PY_GC_COLLECTING (PY_GC_GENERATIONS)
+#define PY_GC_UNREACHABLE (PY_GC_GENERATIONS + 1)
+#define PY_GC_UNTRACKED (PY_GC_GENERATIONS + 2)
+
+/* TODO: Python global state. */
+int py_gc_pending = 0;
+struct py_gc_stats py_gc_stats[PY_GC_GENERATIONS];
+
+/* TODO: Python global state. */
+/* One empty list for each of PY_GC_GENERATIONS. */
+static struct py_gc_head py_gc_lists[PY_GC_GENERATIONS] = {
+		{ &py_gc_lists[0], &py_gc_lists[0], 0, 0 },
+		{ &py_gc_lists[1], &py_gc_lists[1], 0, 0 },
+		{ &py_gc_lists[2], &py_gc_lists[2], 0, 0 }
+};
+static unsigned py_gc_count[PY_GC_GENERATIONS]; /* objects in each list */
+static unsigned py_gc_threshold[PY_GC_GENERATIONS] = { 700, 10, 10 };
+static unsigned py_gc_since[PY_GC_GENERATIONS]; /* younger collections */
+static unsigned long py_gc_budget = 0; /* in microseconds, 0 if not in use */
+static unsigned py_gc_pass = 0; /* left to go over in the oldest generation */
+static unsigned py_gc_long_lived = 0; /* its size when last gone over */
+static unsigned py_gc_promoted = 0; /* objects moved into it since */
+
+static void py_gc_list_init(struct py_gc_head* list) {
+	list->next = list;
+	list->prev = list;
+}
+
+static void py_gc_list_unlink(struct py_gc_head* h) {
+	h->prev->next = h->next;
+	h->next->prev = h->prev;
+}
+
+static void py_gc_list_append(struct py_gc_head* list, struct py_gc_head* h) {
+	h->next = list;
+	h->prev = list->prev;
+	list->prev->next = h;
+	list->prev = h;
+}
+
+/* Moves all of `from' onto the end of `to'. */
+static void py_gc_list_merge(struct py_gc_head* from, struct py_gc_head* to) {
+	if(from->next == from) return;
+
+	from->next->prev = to->prev;
+	to->prev->next = from->next;
+	from->prev->next = to;
+	to->prev = from->prev;
+
+	py_gc_list_init(from);
+}
+
+void* py_gc_alloc(size_t size) {
+	struct py_gc_head* h = py_mem_alloc(sizeof(struct py_gc_head) + size);
+
+	return h ? h + 1 : 0;
+}
+
+void py_gc_free(void* op, size_t size) {
+	py_mem_free(PY_GC_HEAD(op), sizeof(struct py_gc_head) + size);
+}
+
+void py_gc_track(void* op) {
+	struct py_gc_head* h = PY_GC_HEAD(op);
+
+	h->gen = 0;
+	py_gc_list_append(&py_gc_lists[0], h);
+
+	if(++py_gc_count[0] > py_gc_threshold[0] && py_gc_threshold[0]) {
+		py_gc_pending = 1;
+	}
+}
+
+void py_gc_untrack(void* op) {
+	struct py_gc_head* h = PY_GC_HEAD(op);
+
+	if(h->gen == PY_GC_UNTRACKED) return;
+	if(h->gen < PY_GC_GENERATIONS) py_gc_count[h->gen]--;
+
+	py_gc_list_unlink(h);
+	h->gen = PY_GC_UNTRACKED;
+}
+
+/* Visitors */
+
+static struct py_gc_head* py_gc_head_of(struct py_object* op) {
+	if(!op || PY_IS_TAGGED(op) || !py_types[op->type].traverse) return 0;
+
+	return PY_GC_HEAD(op);
+}
+
+static void py_gc_visit_decref(struct py_object** slot, void* arg) {
+	struct py_gc_head* h = py_gc_head_of(*slot);
+
+	(void) arg;
+
+	if(h && h->gen == PY_GC_COLLECTING) h->refs--;
+}
+
+static void py_gc_visit_reachable(struct py_object** slot, void* arg) {
+	struct py_gc_head* h = py_gc_head_of(*slot);
+
+	if(!h) return;
+
+	if(h->gen == PY_GC_UNREACHABLE) {
+		/* Already passed over, so back for another look. */
+		py_gc_list_unlink(h);
+		py_gc_list_append(arg, h);
+		h->gen = PY_GC_COLLECTING;
+		h->refs = 1;
+	}
+	else if(h->gen == PY_GC_COLLECTING && !h->refs) h->refs = 1;
+}
+
+static void py_gc_visit_gather(struct py_object** slot, void* arg) {
+	struct py_gc_head* h = py_gc_head_of(*slot);
+
+	if(!h || h->gen >= PY_GC_GENERATIONS) return;
+
+	py_gc_count[h->gen]--;
+	py_gc_list_unlink(h);
+	py_gc_list_append(arg, h);
+	h->gen = PY_GC_COLLECTING;
+}
+
+static void py_gc_visit_clear(struct py_object** slot, void* arg) {
+	struct py_object* op = *slot;
+
+	(void) arg;
+
+	*slot = 0;
+	py_object_decref(op);
+}
+
+static void py_gc_visit_tracked(struct py_object** slot, void* arg) {
+	struct py_gc_head* h = py_gc_head_of(*slot);
+
+	if(h && h->gen != PY_GC_UNTRACKED) *(int*) arg = 1;
+}
+
+#define PY_GC_OBJECT(h) ((struct py_object*) ((h) + 1))
+#define PY_GC_TRAVERSE(h, visit, arg) \
+		py_types[PY_GC_OBJECT(h)->type].traverse(PY_GC_OBJECT(h), visit, arg)
+
+/*
+ * Tuples can't be changed, so one which has survived a collection holding
+ * nothing that is tracked can never be part of a cycle -- and is dropped from
+ * its generation rather than being gone over again and again. This keeps big
+ * tables of records out of the way.
+ */
+static int py_gc_untrackable(struct py_gc_head* h) {
+	int tracked = 0;
+
+	if(PY_GC_OBJECT(h)->type != PY_TYPE_TUPLE) return 0;
+
+	PY_GC_TRAVERSE(h, py_gc_visit_tracked, &tracked);
+
+	return !tracked;
+}
+
+/*
+ * Collects the objects on `work', all in the PY_GC_COLLECTING state, moving
+ * survivors into generation `gen'. Returns the number of objects freed.
+ */
+static unsigned long py_gc_collect_list(struct py_gc_head* work, unsigned gen) {
+	struct py_gc_head unreachable;
+	struct py_gc_head* h;
+	struct py_gc_head* next;
+	unsigned long n = 0;
+
+	for(h = work->next; h != work; h = h->next) {
+		h->refs = PY_GC_OBJECT(h)->refcount;
+	}
+
+	for(h = work->next; h != work; h = h->next) {
+		PY_GC_TRAVERSE(h, py_gc_visit_decref, 0);
+	}
+
+	/*
+	 * Objects are moved back onto the end of `work' as they're found to be
+	 * reachable after all, so that what they refer to gets looked at too.
+	 */
+	py_gc_list_init(&unreachable);
+	for(h = work->next; h != work; h = next) {
+		if(h->refs) {
+			PY_GC_TRAVERSE(h, py_gc_visit_reachable, work);
+			next = h->next;
+		}
+		else {
+			next = h->next;
+			py_gc_list_unlink(h);
+			py_gc_list_append(&unreachable, h);
+			h->gen = PY_GC_UNREACHABLE;
+		}
+	}
+
+	for(h = work->next; h != work; h = next) {
+		next = h->next;
+
+		if(py_gc_untrackable(h)) {
+			py_gc_list_unlink(h);
+			h->gen = PY_GC_UNTRACKED;
+		}
+		else {
+			h->gen = gen;
+			py_gc_count[gen]++;
+		}
+	}
+	py_gc_list_merge(work, &py_gc_lists[gen]);
+
+	/* Keep the garbage alive until all its references are gone. */
+	for(h = unreachable.next; h != &unreachable; h = h->next) {
+		py_object_incref(PY_GC_OBJECT(h));
+	}
+
+	for(h = unreachable.next; h != &unreachable; h = h->next) {
+		PY_GC_TRAVERSE(h, py_gc_visit_clear, 0);
+	}
+
+	/* Each goes on to `gen' in case, against all odds, it survives. */
+	while((h = unreachable.next) != &unreachable) {
+		py_gc_list_unlink(h);
+		py_gc_list_append(&py_gc_lists[gen], h);
+		h->gen = gen;
+		py_gc_count[gen]++;
+
+		py_object_decref(PY_GC_OBJECT(h));
+		n++;
+	}
+
+	return n;
+}
+
+/* Collects generation `gen' and all younger ones. */
+static unsigned long py_gc_collect_generation(unsigned gen) {
+	struct py_gc_head work;
+	struct py_gc_head* h;
+	unsigned target = gen < PY_GC_OLDEST ? gen + 1 : gen;
+	unsigned before = py_gc_count[target];
+	unsigned long n;
+	unsigned i;
+
+	py_gc_list_init(&work);
+	for(i = 0; i <= gen; i++) {
+		py_gc_list_merge(&py_gc_lists[i], &work);
+		py_gc_count[i] = 0;
+		py_gc_since[i] = 0;
+	}
+
+	for(h = work.next; h != &work; h = h->next) h->gen = PY_GC_COLLECTING;
+
+	n = py_gc_collect_list(&work, target);
+
+	if(gen < PY_GC_OLDEST) {
+		py_gc_since[target]++;
+
+		if(target == PY_GC_OLDEST) {
+			py_gc_promoted += py_gc_count[target] - before;
+		}
+	}
+	else {
+		py_gc_pass = 0;
+		py_gc_long_lived = py_gc_count[target];
+		py_gc_promoted = 0;
+	}
+
+	py_gc_stats[gen].collections++;
+	py_gc_stats[gen].collected += n;
+
+	return n;
+}
+
+/*
+ * Collects one slice of the oldest generation, returning the number of
+ * objects freed. Survivors go to the end of the generation, after anything
+ * still to be gone over in the current pass.
+ */
+static unsigned long py_gc_collect_slice(void) {
+	struct py_gc_head* oldest = &py_gc_lists[PY_GC_OLDEST];
+	struct py_gc_head work;
+	struct py_gc_head* h;
+	unsigned long n;
+	unsigned i;
+
+	py_gc_list_init(&work);
+	for(i = 0; i < PY_GC_SLICE && py_gc_pass; i++, py_gc_pass--) {
+		if((h = oldest->next) == oldest) {
+			py_gc_pass = 0;
+			break;
+		}
+
+		py_gc_count[PY_GC_OLDEST]--;
+		py_gc_list_unlink(h);
+		py_gc_list_append(&work, h);
+		h->gen = PY_GC_COLLECTING;
+	}
+
+	/* Bring in everything the slice refers to, from any generation. */
+	for(h = work.next; h != &work; h = h->next) {
+		PY_GC_TRAVERSE(h, py_gc_visit_gather, &work);
+	}
+
+	n = py_gc_collect_list(&work, PY_GC_OLDEST);
+
+	py_gc_stats[PY_GC_OLDEST].slices++;
+	py_gc_stats[PY_GC_OLDEST].collected += n;
+
+	if(!py_gc_pass) {
+		py_gc_stats[PY_GC_OLDEST].collections++;
+		py_gc_long_lived = py_gc_count[PY_GC_OLDEST];
+		py_gc_promoted = 0;
+	}
+
+	return n;
+}
+
+/* Goes on with the current pass over the oldest generation until `end'. */
+static unsigned long py_gc_step_until(clock_t end) {
+	unsigned long n = 0;
+
+	if(!py_gc_pass) {
+		py_gc_pass = py_gc_count[PY_GC_OLDEST];
+		py_gc_since[PY_GC_OLDEST] = 0;
+
+		if(!py_gc_pass) return 0;
+	}
+
+	/* Always get somewhere, however small the budget. */
+	do n += py_gc_collect_slice();
+	while(py_gc_pass && clock() < end);
+
+	return n;
+}
+
+static clock_t py_gc_deadline(clock_t start, unsigned long budget) {
+	return start + (clock_t) ((double) budget * CLOCKS_PER_SEC / 1000000.0);
+}
+
+/* Runs the collection which is due, as flagged by `py_gc_pending'. */
+void py_gc_poll(void) {
+	clock_t start = clock();
+	unsigned gen = 0;
+	unsigned i;
+
+	py_gc_pending = 0;
+
+	/*
+	 * Going over the oldest generation costs in proportion to its size, so
+	 * it also waits for a quarter as much again to have been moved into it --
+	 * building up a big structure would take quadratic time otherwise.
+	 */
+	for(i = 1; i < PY_GC_GENERATIONS && py_gc_threshold[i]; i++) {
+		if(py_gc_since[i] <= py_gc_threshold[i]) continue;
+		if(i == PY_GC_OLDEST && py_gc_promoted < py_gc_long_lived / 4) break;
+
+		gen = i;
+	}
+
+	if(py_gc_budget && (gen == PY_GC_OLDEST || py_gc_pass)) {
+		py_gc_collect_generation(gen < PY_GC_OLDEST ? gen : PY_GC_OLDEST - 1);
+		py_gc_step_until(py_gc_deadline(start, py_gc_budget));
+	}
+	else py_gc_collect_generation(gen);
+}
+
+/*
+ * Collects generation `gen' and all younger ones -- everything, for the
+ * oldest -- at once. Returns the number of objects freed.
+ */
+unsigned long py_gc_collect(unsigned gen) {
+	if(gen > PY_GC_OLDEST) gen = PY_GC_OLDEST;
+
+	return py_gc_collect_generation(gen);
+}
+
+/*
+ * Goes over the oldest generation for up to `budget' microseconds, starting
+ * a new pass if there is none under way -- for hosts to make use of idle
+ * time. Returns the number of objects freed.
+ */
+unsigned long py_gc_step(unsigned long budget) {
+	return py_gc_step_until(py_gc_deadline(clock(), budget));
+}
+
+void py_gc_set_threshold(unsigned gen, unsigned threshold) {
+	if(gen < PY_GC_GENERATIONS) py_gc_threshold[gen] = threshold;
+}
+
+/* Sets the time budget of incremental collection; 0 collects all at once. */
+void py_gc_set_budget(unsigned long budget) {
+	py_gc_budget = budget;
+}
+
+void py_gc_print_stats(FILE* fp) {
+	unsigned i;
+
+	for(i = 0; i < PY_GC_GENERATIONS; i++) {
+		fprintf(
+				fp, "Generation %u: %u objects, %lu collections (%lu slices), "
+					"%lu collected\n",
+				i, py_gc_count[i], py_gc_stats[i].collections,
+				py_gc_stats[i].slices, py_gc_stats[i].collected);
+	}
+}
+#endif
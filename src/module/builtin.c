@@ -19,6 +19,7 @@
 #include <python/object/list.h>
 #include <python/object/dict.h>
 #include <python/object/tuple.h>
+#include <python/object/range.h>
 
 /* Predefined exceptions */
 
@@ -35,11 +36,11 @@ static struct py_object* py_builtin_float(
 	(void) env;
 	(void) self;
 
-	if(args && args->type == PY_TYPE_FLOAT) {
+	if(args && PY_TYPE(args) == PY_TYPE_FLOAT) {
 		py_object_incref(args);
 		return args;
 	}
-	else if(args && args->type == PY_TYPE_INT) {
+	else if(args && PY_TYPE(args) == PY_TYPE_INT) {
 		py_value_t x = py_int_get(args);
 		return py_float_new((double) x);
 	}
@@ -55,11 +56,11 @@ static struct py_object* py_builtin_int(
 	(void) env;
 	(void) self;
 
-	if(args && args->type == PY_TYPE_INT) {
+	if(args && PY_TYPE(args) == PY_TYPE_INT) {
 		py_object_incref(args);
 		return args;
 	}
-	else if(args && args->type == PY_TYPE_FLOAT) {
+	else if(args && PY_TYPE(args) == PY_TYPE_FLOAT) {
 		double x = py_float_get(args);
 		return py_int_new((py_value_t) x);
 	}
@@ -82,7 +83,7 @@ static struct py_object* py_builtin_len(
 	}
 
 	if(py_is_varobject(args)) len = py_varobject_size(args);
-	else if(args->type == PY_TYPE_DICT) len = ((struct py_dict*) args)->used;
+	else if(PY_TYPE(args) == PY_TYPE_DICT) len = ((struct py_dict*) args)->used;
 	else {
 		py_error_set_string(py_type_error, "len() of unsized object");
 		return NULL;
@@ -92,26 +93,22 @@ static struct py_object* py_builtin_len(
 }
 
 /*
- * TODO: This can probably be simplified/split-off since it's such a core
- * 		 Function.
+ * Returns what `range' gives for `args' as a range object, whose items are
+ * made on demand. Only for loops are handed these (see PY_OP_LOOP_CALL) --
+ * `range' itself returns a list of the items, as scripts may change it.
  */
-static struct py_object* py_builtin_range(
-		struct py_env* env, struct py_object* self, struct py_object* args) {
-
+struct py_object* py_builtin_range_lazy(struct py_object* args) {
 	static const char errmsg[] = "range() requires 1-3 int arguments";
 
 	unsigned i, n;
 	py_value_t low, high, step;
 
-	(void) env;
-	(void) self;
-
-	if(args && (args->type == PY_TYPE_INT)) {
+	if(args && (PY_TYPE(args) == PY_TYPE_INT)) {
 		low = 0;
 		high = py_int_get(args);
 		step = 1;
 	}
-	else if(!args || args->type != PY_TYPE_TUPLE) {
+	else if(!args || PY_TYPE(args) != PY_TYPE_TUPLE) {
 		py_error_set_string(py_type_error, errmsg);
 		return NULL;
 	}
@@ -124,7 +121,7 @@ static struct py_object* py_builtin_range(
 		}
 
 		for(i = 0; i < n; i++) {
-			if(py_tuple_get(args, i)->type != PY_TYPE_INT) {
+			if(PY_TYPE(py_tuple_get(args, i)) != PY_TYPE_INT) {
 				py_error_set_string(py_type_error, errmsg);
 				return NULL;
 			}
@@ -148,24 +145,57 @@ static struct py_object* py_builtin_range(
 	}
 
 	/* TODO: ought to check overflow of subion */
-	if(step > 0) n = (unsigned) ((high - low + step - 1) / step);
-	else n = (unsigned) ((high - low + step + 1) / step);
+	if(step > 0) high = (high - low + step - 1) / step;
+	else high = (high - low + step + 1) / step;
 
-	if(!(args = py_list_new(n))) return py_error_set_nomem();
+	/* An empty range rather than a negative length. */
+	return py_range_new(low, step, high > 0 ? (unsigned) high : 0);
+}
+
+/*
+ * TODO: This can probably be simplified/split-off since it's such a core
+ * 		 Function.
+ */
+static struct py_object* py_builtin_range(
+		struct py_env* env, struct py_object* self, struct py_object* args) {
+
+	struct py_object* range;
+	struct py_object* list;
+	unsigned i, n;
+
+	(void) env;
+	(void) self;
+
+	if(!(range = py_builtin_range_lazy(args))) return 0;
+
+	n = py_varobject_size(range);
+	if(!(list = py_list_new(n))) {
+		py_object_decref(range);
+		return py_error_set_nomem();
+	}
 
 	for(i = 0; i < n; i++) {
-		struct py_object* w = py_int_new(low);
+		struct py_object* w;
 
-		if(w == NULL) {
-			py_object_decref(args);
-			return NULL;
+		if(!(w = py_range_ind(range, i))) {
+			py_object_decref(list);
+			py_object_decref(range);
+			return 0;
 		}
 
-		py_list_set(args, i, w);
-		low += step;
+		py_list_set(list, i, w);
 	}
 
-	return args;
+	py_object_decref(range);
+
+	return list;
+}
+
+/* Whether `op' is the `range' builtin, which loops can call lazily. */
+int py_builtin_is_range(struct py_object* op) {
+	if(PY_TYPE(op) != PY_TYPE_METHOD) return 0;
+
+	return ((struct py_method*) op)->method == py_builtin_range;
 }
 
 static struct py_object* py_builtin_append(
@@ -177,8 +207,8 @@ static struct py_object* py_builtin_append(
 	(void) env;
 	(void) self;
 
-	if(!args || args->type != PY_TYPE_TUPLE ||
-		(lp = py_tuple_get(args, 0))->type != PY_TYPE_LIST) {
+	if(!args || PY_TYPE(args) != PY_TYPE_TUPLE ||
+		PY_TYPE(lp = py_tuple_get(args, 0)) != PY_TYPE_LIST) {
 
 		py_error_set_badarg();
 		return 0;
@@ -201,9 +231,9 @@ static struct py_object* py_builtin_insert(
 	(void) env;
 	(void) self;
 
-	if(!args || args->type != PY_TYPE_TUPLE || py_varobject_size(args) != 2 ||
-			!(lp = py_tuple_get(args, 0)) || lp->type != PY_TYPE_LIST ||
-			!(ind = py_tuple_get(args, 1)) || ind->type != PY_TYPE_INT ||
+	if(!args || PY_TYPE(args) != PY_TYPE_TUPLE || py_varobject_size(args) != 2 ||
+			!(lp = py_tuple_get(args, 0)) || PY_TYPE(lp) != PY_TYPE_LIST ||
+			!(ind = py_tuple_get(args, 1)) || PY_TYPE(ind) != PY_TYPE_INT ||
 			!(op = py_tuple_get(args, 2))) {
 
 		py_error_set_badarg();
@@ -237,7 +267,7 @@ static struct py_object* py_builtin_notv(
 	(void) env;
 	(void) self;
 
-	if(args->type != PY_TYPE_INT) {
+	if(PY_TYPE(args) != PY_TYPE_INT) {
 		py_error_set_badarg();
 		return 0;
 	}
@@ -270,6 +300,10 @@ struct py_object* py_builtin_get(const char* name) {
 	return py_dict_lookup(py_builtin_dict, name);
 }
 
+struct py_object* py_builtin_get_dict(void) {
+	return py_builtin_dict;
+}
+
 static struct py_object* py_exception_new(
 		const char* name, const char* message) {
 
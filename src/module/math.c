@@ -21,11 +21,11 @@ typedef py_value_t (*py_math_val2_t)(py_value_t, py_value_t);
 static int py_arg_double(struct py_object* args, double* px) {
 	if(args == NULL) return py_error_set_badarg();
 
-	if(args->type == PY_TYPE_FLOAT) {
+	if(PY_TYPE(args) == PY_TYPE_FLOAT) {
 		*px = py_float_get(args);
 		return 1;
 	}
-	else if(args->type == PY_TYPE_INT) {
+	else if(PY_TYPE(args) == PY_TYPE_INT) {
 		*px = (double) py_int_get(args);
 		return 1;
 	}
@@ -36,7 +36,7 @@ static int py_arg_double(struct py_object* args, double* px) {
 static int py_arg_double_double(
 		struct py_object* args, double* px, double* py) {
 
-	if(!args || args->type != PY_TYPE_TUPLE || py_varobject_size(args) != 2) {
+	if(!args || PY_TYPE(args) != PY_TYPE_TUPLE || py_varobject_size(args) != 2) {
 		return py_error_set_badarg();
 	}
 
@@ -119,7 +119,7 @@ static struct py_object* py_math_bitlist_op(
 	py_value_t res = 0;
 	unsigned i;
 
-	if(args->type != PY_TYPE_TUPLE) {
+	if(PY_TYPE(args) != PY_TYPE_TUPLE) {
 		py_error_set_badarg();
 		return 0;
 	}
@@ -165,9 +165,9 @@ static struct py_object* py_math_val2(
 	struct py_object* a;
 	struct py_object* b;
 
-	if(args->type != PY_TYPE_TUPLE ||
-		!(a = py_tuple_get(args, 0)) || a->type != PY_TYPE_INT ||
-		!(b = py_tuple_get(args, 1)) || b->type != PY_TYPE_INT) {
+	if(PY_TYPE(args) != PY_TYPE_TUPLE ||
+		!(a = py_tuple_get(args, 0)) || PY_TYPE(a) != PY_TYPE_INT ||
+		!(b = py_tuple_get(args, 1)) || PY_TYPE(b) != PY_TYPE_INT) {
 
 		py_error_set_badarg();
 		return 0;
@@ -212,7 +212,7 @@ static struct py_object* py_math_notb(
 	(void) env;
 	(void) self;
 
-	if(!args || args->type != PY_TYPE_INT) {
+	if(!args || PY_TYPE(args) != PY_TYPE_INT) {
 		py_error_set_badarg();
 		return 0;
 	}
@@ -7,43 +7,116 @@
 
 #include <python/std.h>
 #include <python/errors.h>
+#include <python/gc.h>
+
+#include <python/object/range.h>
+#include <python/object/tuple.h>
+#include <python/object/list.h>
+#include <python/object/dict.h>
 
 #include <asys/log.h>
 
+/* Containers are allocated with room for the cycle collector's header. */
+static void* py_object_alloc(enum py_type tp, size_t size) {
+	if(py_types[tp].traverse) return py_gc_alloc(size);
+
+	return py_mem_alloc(size);
+}
+
 /*
  * Object allocation routines used by the NEWOBJ macro.
  * These are used by the individual routines for object creation.
  * Do not call them otherwise, they do not initialize the object!
  */
 void* py_object_new(enum py_type tp) {
-	struct py_object* op = malloc(py_types[tp].size);
+	struct py_object* op = py_object_alloc(tp, py_types[tp].size);
 	if(op == NULL) return py_error_set_nomem();
 
 	py_object_newref(op);
 	op->type = tp;
 
+	if(py_types[tp].traverse) py_gc_track(op);
+
 	return op;
 }
 
+void* py_varobject_new(enum py_type tp, unsigned size) {
+	struct py_varobject* op;
+
+	if(size > PY_VAROBJECT_MAX) return py_error_set_nomem();
+
+	op = py_object_alloc(tp, py_types[tp].size + py_types[tp].itemsize * size);
+	if(op == NULL) return py_error_set_nomem();
+
+	py_object_newref(op);
+	op->type = tp;
+	op->size = size;
+
+	if(py_types[tp].traverse) py_gc_track(op);
+
+	return op;
+}
+
+/* Returns an object's memory to the allocator, once it is done with. */
+void py_object_delete(struct py_object* op) {
+	size_t size = py_types[op->type].size;
+
+	if(py_types[op->type].itemsize) {
+		size += py_types[op->type].itemsize * py_varobject_size(op);
+	}
+
+	if(py_types[op->type].traverse) {
+		py_gc_untrack(op);
+		py_gc_free(op, size);
+	}
+	else py_mem_free(op, size);
+}
+
 int py_object_cmp(const struct py_object* v, const struct py_object* w) {
 	if(v == w) return 0;
 	if(v == NULL) return -1;
 	if(w == NULL) return 1;
 
-	if(v->type != w->type) return (v < w) ? -1 : 1;
-	if(py_types[v->type].cmp == NULL) return (v < w) ? -1 : 1;
+	if(PY_TYPE(v) != PY_TYPE(w)) return (v < w) ? -1 : 1;
+	if(py_types[PY_TYPE(v)].cmp == NULL) return (v < w) ? -1 : 1;
+
+	return py_types[PY_TYPE(v)].cmp(v, w);
+}
+
+/* A tuple is hashable if everything in it is. */
+static int py_object_hashable(struct py_object* op) {
+	unsigned i, n;
 
-	return py_types[v->type].cmp(v, w);
+	if(!op || !py_types[PY_TYPE(op)].hash) return 0;
+	if(PY_TYPE(op) != PY_TYPE_TUPLE) return 1;
+
+	n = py_varobject_size(op);
+	for(i = 0; i < n; i++) {
+		if(!py_object_hashable(py_tuple_get(op, i))) return 0;
+	}
+
+	return 1;
+}
+
+/* Sets `*hash' to the hash of `op', returning -1 if it is unhashable. */
+int py_object_hash(struct py_object* op, unsigned long* hash) {
+	if(!py_object_hashable(op)) return -1;
+
+	*hash = py_types[PY_TYPE(op)].hash(op);
+
+	return 0;
 }
 
 int py_is_varobject(const void* op) {
-	enum py_type type = ((struct py_varobject*) op)->type;
+	enum py_type type = PY_TYPE(op);
 
 	return type == PY_TYPE_LIST || type == PY_TYPE_TUPLE ||
-			type == PY_TYPE_STRING;
+			type == PY_TYPE_STRING || type == PY_TYPE_RANGE;
 }
 
 unsigned py_varobject_size(const void* op) {
+	if(PY_TYPE(op) == PY_TYPE_RANGE) return ((struct py_range*) op)->length;
+
 	return ((struct py_varobject*) op)->size;
 }
 
@@ -53,7 +126,7 @@ unsigned py_varobject_size(const void* op) {
  * type, so there is exactly one (which is indestructible, by the way).
  */
 
-struct py_object py_none_object = { PY_TYPE_NONE, 1 };
+struct py_object py_none_object = { PY_TYPE_NONE, PY_REFCOUNT_IMMORTAL };
 
 #ifdef PY_REF_TRACE
 /* TODO: Python global state. */
@@ -65,53 +138,161 @@ long py_ref_total = 0;
 long py_object_total = 0;
 #endif
 
-void* py_object_incref(void* p) {
+#ifdef PY_REF_DEBUG
+/* The rest of py_object_incref for mortal objects, with checks. */
+void* py_object_incref_impl(void* p) {
 	struct py_object* op = p;
 
-	if(!p) return 0;
-
-#ifdef PY_REF_DEBUG
 	py_ref_total++;
-#endif
 
 	op->refcount++;
 
-#ifndef NDEBUG
 	/* TODO: Formalise this. */
-	if(op != PY_NONE && op->refcount > 10000) {
+	if(op->refcount > 10000) {
 		asys_log(
 				__FILE__, "Suspicious refcount `%u' on object `%p'",
 				op->refcount, p);
 	}
-#endif
 
 	return op;
 }
 
-void* py_object_decref(void* p) {
+/* The rest of py_object_decref for mortal objects, with checks. */
+void* py_object_decref_impl(void* p) {
 	struct py_object* op = p;
 
-	if(!p) return 0;
-
-#ifndef NDEBUG
 	if(!op->refcount) {
 		asys_log(__FILE__, "Possible double free on object `%p'", p);
 		return 0;
 	}
+
+	py_ref_total--;
+
+	if(!--op->refcount) py_object_dealloc(op);
+
+	return op;
+}
 #endif
 
+#define PY_OBJECT_CHUNK (256) /* Items let go of per drain step */
+
+/* TODO: Python global state. */
+static int py_object_deferred = 0;
+static struct py_object** py_object_queue = 0; /* used as a stack */
+static unsigned py_object_queued = 0;
+static unsigned py_object_queue_size = 0;
+
+static void py_object_free(struct py_object* op) {
 #ifdef PY_REF_DEBUG
-	py_ref_total--;
+	py_object_total--;
 #endif
 
-	if(--op->refcount <= 0) {
-		py_object_total--;
+	py_object_unref(op);
+	py_types[op->type].dealloc(op);
+}
+
+/* Returns zero if there is no room to queue the object. */
+static int py_object_defer(struct py_object* op) {
+	if(py_object_queued == py_object_queue_size) {
+		unsigned size = py_object_queue_size ? py_object_queue_size * 2 : 64;
+		struct py_object** queue;
+
+		queue = realloc(py_object_queue, size * sizeof(struct py_object*));
+		if(!queue) return 0;
 
-		py_object_unref(op);
-		py_types[op->type].dealloc(op);
+		py_object_queue = queue;
+		py_object_queue_size = size;
 	}
 
-	return op;
+	/* It is on its way out, and of no more interest to the collector. */
+	py_gc_untrack(op);
+
+	py_object_queue[py_object_queued++] = op;
+
+	return 1;
+}
+
+/* Frees an object whose last reference has been dropped. */
+void py_object_dealloc(struct py_object* op) {
+	if(py_object_deferred) {
+		enum py_type tp = op->type;
+
+		if(tp == PY_TYPE_TUPLE || tp == PY_TYPE_LIST || tp == PY_TYPE_DICT) {
+			if(py_object_defer(op)) return;
+		}
+	}
+
+	py_object_free(op);
+}
+
+/*
+ * Lets go of up to PY_OBJECT_CHUNK items at the end of a queued list or
+ * dict, returning nonzero if it still has more than that left -- what is
+ * left is let go of when it is freed.
+ */
+static int py_object_shed(struct py_object* op) {
+	unsigned i;
+
+	if(op->type == PY_TYPE_LIST) {
+		struct py_list* lp = (void*) op;
+
+		if(lp->ob.size <= PY_OBJECT_CHUNK) return 0;
+
+		for(i = 0; i < PY_OBJECT_CHUNK; i++) {
+			py_object_decref(lp->item[--lp->ob.size]);
+		}
+
+		return 1;
+	}
+
+	if(op->type == PY_TYPE_DICT) {
+		struct py_dict* dp = (void*) op;
+
+		if(dp->fill <= PY_OBJECT_CHUNK) return 0;
+
+		for(i = 0; i < PY_OBJECT_CHUNK; i++) {
+			struct py_dictentry* ep = &dp->table[--dp->fill];
+
+			py_object_decref(ep->key);
+			py_object_decref(ep->value);
+		}
+
+		return 1;
+	}
+
+	return 0;
+}
+
+void py_object_set_deferred(int deferred) {
+	py_object_deferred = deferred;
+}
+
+/*
+ * Frees queued objects, for up to `steps' objects or chunks and `budget'
+ * microseconds. Returns the number of steps taken.
+ */
+unsigned long py_object_drain(unsigned long steps, unsigned long budget) {
+	clock_t end = clock() + (clock_t) (budget * (CLOCKS_PER_SEC / 1000000.0));
+	unsigned long n = 0;
+
+	while(py_object_queued) {
+		struct py_object* op;
+
+		if(steps && n == steps) break;
+		if(budget && n && !(n % 16) && clock() >= end) break;
+
+		/* Taken off first -- freeing it may well queue more. */
+		op = py_object_queue[--py_object_queued];
+		n++;
+
+		if(!py_object_shed(op) || !py_object_defer(op)) py_object_free(op);
+	}
+
+	return n;
+}
+
+unsigned py_object_pending(void) {
+	return py_object_queued;
 }
 
 void* py_object_newref(void* p) {
@@ -136,6 +317,20 @@ void* py_object_newref(void* p) {
 	return op;
 }
 
+void py_object_immortalise(void* p) {
+	struct py_object* op = p;
+
+	if(!p || PY_IS_TAGGED(p) || PY_IS_IMMORTAL(p)) return;
+
+#ifdef PY_REF_DEBUG
+	py_ref_total -= (long) op->refcount;
+	py_object_total--;
+#endif
+
+	py_object_unref(op);
+	op->refcount = PY_REFCOUNT_IMMORTAL;
+}
+
 void py_object_unref(void* p) {
 #ifdef PY_REF_TRACE
 	struct py_object* op;
@@ -24,17 +24,17 @@ struct py_object* py_class_new(struct py_object* methods) {
 void py_class_dealloc(struct py_object* op) {
 	py_object_decref(((struct py_class*) op)->attr);
 
-	free(op);
+	py_object_delete(op);
 }
 
-struct py_object* py_class_get_attr(struct py_object* op, const char* name) {
-	struct py_object* v;
+void py_class_traverse(struct py_object* op, py_visit_t visit, void* arg) {
+	visit(&((struct py_class*) op)->attr, arg);
+}
 
-	if((v = py_dict_lookup(((struct py_class*) op)->attr, name))) {
-		return py_object_incref(v);
-	}
+struct py_object* py_class_get_attr(
+		struct py_object* op, struct py_object* name) {
 
-	return 0;
+	return py_dict_lookup_object(((struct py_class*) op)->attr, name);
 }
 
 /* We're not done yet: next, we define class member objects... */
@@ -62,20 +62,29 @@ void py_class_member_dealloc(struct py_object* op) {
 	py_object_decref(cm->class);
 	py_object_decref(cm->attr);
 
-	free(op);
+	py_object_delete(op);
+}
+
+void py_class_member_traverse(
+		struct py_object* op, py_visit_t visit, void* arg) {
+
+	struct py_class_member* cm = (void*) op;
+
+	visit((struct py_object**) &cm->class, arg);
+	visit(&cm->attr, arg);
 }
 
 struct py_object* py_class_member_get_attr(
-		struct py_object* op, const char* name) {
+		struct py_object* op, struct py_object* name) {
 
 	struct py_class_member* cm = (void*) op;
 	struct py_object* v;
 
-	if((v = py_dict_lookup(cm->attr, name))) return py_object_incref(v);
+	if((v = py_dict_lookup_object(cm->attr, name))) return v;
 
 	if(!(v = py_class_get_attr((void*) cm->class, name))) return v;
 
-	if(v->type == PY_TYPE_FUNC) {
+	if(PY_TYPE(v) == PY_TYPE_FUNC) {
 		struct py_object* w = py_class_method_new(v, (struct py_object*) cm);
 		py_object_decref(v);
 		return w;
@@ -117,5 +126,14 @@ void py_class_method_dealloc(struct py_object* op) {
 	py_object_decref(cm->func);
 	py_object_decref(cm->self);
 
-	free(op);
+	py_object_delete(op);
+}
+
+void py_class_method_traverse(
+		struct py_object* op, py_visit_t visit, void* arg) {
+
+	struct py_class_method* cm = (void*) op;
+
+	visit(&cm->func, arg);
+	visit(&cm->self, arg);
 }
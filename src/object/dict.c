@@ -5,214 +5,637 @@
 
 /* Dictionary object implementation; using a hash table */
 
-/*
- * TODO: Although this may look professional, I didn't think very hard
- *       about the problem, and it is possible that obvious improvements exist.
- *       A similar module that I saw by Chris Torek:
- *        - uses chaining instead of hashed linear probing
- *        - remembers the hash value with the entry to speed up table resizing
- *        - sets the table size to a power of 2
- *        - uses a different hash function:
- *               h = 0; p = str; while (*p) h = (h<<5) - h + *p++;
- */
-
 /* TODO: Fix overly fatal EH in here. */
-/* TODO: Do dict keys need to be string *objects*? */
 
 #include <python/std.h>
+#include <python/alloc.h>
 
 #include <python/object/string.h>
+#include <python/object/int.h>
 #include <python/object/dict.h>
 
 /*
- * Table of primes suitable as keys, in ascending order.
- * The first line are the largest primes less than some powers of two,
- * the second line is the largest prime less than 6000,
- * and the third line is a selection from Knuth, Vol. 3, Sec. 6.1, Table 1.
- * The final value is a sentinel and should cause the memory allocation
- * of that many entries to fail (if none of the earlier values cause such
- * failure already).
+ * A dict is two arrays in one block. The entries -- key, value and the key's
+ * hash -- are appended in insertion order, so that they are dense and walking
+ * them gives the keys in the order they came. The index is an open-addressed
+ * hash table of entry numbers, its size a power of two; it is as wide as the
+ * number of entries needs, so a small dict pays a byte a slot rather than a
+ * whole entry for every empty one.
+ *
+ * An index slot is PY_DICT_EMPTY, or PY_DICT_DUMMY if its entry was removed
+ * -- the probe sequence of a later key may run through it -- or else the
+ * number of an entry. Entries only ever get appended, up to two-thirds of the
+ * index size, so the index always has an empty slot to end a search at. When
+ * the entries run out the table is rebuilt, sized to the keys in use -- which
+ * leaves out cleared entries and dummy slots, and may make it smaller.
+ *
+ * The probe sequence starts at the hash masked by the index size. The hash
+ * bits above the mask are then brought in a few at a time, after which the
+ * recurrence i = 5i + 1 visits every slot of a power-of-two table.
+ *
+ * Tables of PY_DICT_GROUPED slots or more -- where probe sequences run long
+ * enough for it to matter -- also keep a control byte for each slot, ahead of
+ * the slots of its group: PY_DICT_CTRL_EMPTY, PY_DICT_CTRL_DUMMY, or the top
+ * 7 bits of the hash of the slot's key. These tables are probed a group of
+ * PY_DICT_GROUP slots at a time, the group's control bytes being compared
+ * with the key's in one go; only slots whose bytes match lead to an entry and
+ * its key. Groups start at the hash masked by the number of groups and go on
+ * by 1, 2, 3... groups, which visits every group. Where SSE2 or AVX2 are to
+ * be had -- found out at run time -- a group takes one or two instructions
+ * to compare; elsewhere, or with PY_NO_SIMD defined, it is done a word at a
+ * time. Past PY_DICT_GROUPED_MAX slots the index no longer stays in cache,
+ * and the control bytes cost more in misses than they save in probes.
+ *
+ * Keys are strings, ints, floats, or tuples of those -- anything with a hash
+ * method (see `py_object_hash'). Keys of different types never match, so 1
+ * and 1.0 are different keys.
  */
 
-static unsigned primes[] = {
-		3, 7, 13, 31, 61, 127, 251, 509, 1021, 2017, 4093, 5987, 9551, 15683,
-		19609, 31397, 0xffffffff /* All bits set -- truncation OK */
-};
+#define PY_DICT_MINSIZE (4)
+#define PY_DICT_USABLE(size) ((size) / 3 * 2)
+#define PY_DICT_PERTURB_SHIFT (5)
 
-/* String used as dummy key to fill deleted entries */
-/* Initialized by first call to py_dict_new() */
+#define PY_DICT_EMPTY (-1)
+#define PY_DICT_DUMMY (-2)
+
+#define PY_DICT_GROUP (16)
+#define PY_DICT_GROUPED (128)
+#define PY_DICT_GROUPED_MAX (0x10000)
+
+#define PY_DICT_IS_GROUPED(size) \
+		((size) >= PY_DICT_GROUPED && (size) <= PY_DICT_GROUPED_MAX)
+
+#define PY_DICT_CTRL_EMPTY (0x80)
+#define PY_DICT_CTRL_DUMMY (0xFE)
+
+#define PY_DICT_TAG(hash) \
+		((unsigned char) ((hash) >> (sizeof(unsigned long) * CHAR_BIT - 7)))
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+	!defined(PY_NO_SIMD)
+
+# define PY_DICT_SIMD
+# include <immintrin.h>
+#endif
+
+/* Last version handed out to a dict -- 0 is never used */
 /* TODO: Python global state. */
-static struct py_object* dummy;
+static unsigned long py_dict_version = 0;
+
+/* Bytes in an index slot, for a table of `size' slots. */
+static unsigned py_dict_width(unsigned size) {
+	if(size <= 0x80) return 1;
+	if(size <= 0x8000) return 2;
+
+	return 4;
+}
 
 /*
- * To ensure the lookup algorithm terminates, the table size must be a
- * prime number and there must be at least one NULL key in the table.
- * The value fill is the number of non-NULL keys; used is the number
- * of non-NULL, non-dummy keys.
- * To avoid slowing down lookups on a near-full table, we resize the table
- * when it is more than half filled.
+ * Bytes in the index, rounded up to keep the entries after it aligned. A
+ * grouped table has each group's control bytes just ahead of its slots.
  */
+static size_t py_dict_index_size(unsigned size) {
+	size_t index = (size_t) size * py_dict_width(size);
 
-struct py_object* py_dict_new(void) {
-	struct py_dict* dp;
+	if(PY_DICT_IS_GROUPED(size)) return index + size;
+
+	return (index + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+}
+
+static size_t py_dict_block_size(unsigned size) {
+	size_t index = py_dict_index_size(size);
+
+	return index + PY_DICT_USABLE(size) * sizeof(struct py_dictentry);
+}
+
+/* The control bytes of group `g' of a grouped table, its slots after them. */
+static unsigned char* py_dict_group(struct py_dict* dp, unsigned g) {
+	size_t stride = PY_DICT_GROUP * (1 + py_dict_width(dp->size));
+
+	return (unsigned char*) dp->index + g * stride;
+}
+
+/*
+ * Compares a group of control bytes with a tag, giving a mask of the slots
+ * which match in the low PY_DICT_GROUP bits and of those which are empty in
+ * the PY_DICT_GROUP bits above them.
+ */
+typedef unsigned py_dict_match_t(const unsigned char*, unsigned char);
 
-	/* TODO: This really doesn't need to be here. */
-	if(!dummy) { /* Auto-initialize dummy */
-		if(!(dummy = py_string_new(""))) return 0;
+/*
+ * Multiplying the low bits of the bytes of a word by this gathers them, in
+ * order, into its top PY_DICT_WORD bits.
+ */
+#define PY_DICT_WORD (sizeof(unsigned long))
+#if ULONG_MAX > 0xFFFFFFFFUL
+# define PY_DICT_GATHER (0x0102040810204080UL)
+#else
+# define PY_DICT_GATHER (0x10204080UL)
+#endif
+
+/*
+ * A word of control bytes at a time. Those equal to the tag come out as
+ * zero bytes of `x', found exactly -- adding 0x7F to the low bits of a byte
+ * carries into its top bit unless they are all clear, and no further. Empty
+ * bytes are the only ones with the top bit set and the next one clear.
+ */
+static unsigned py_dict_match_scalar(
+		const unsigned char* ctrl, unsigned char tag) {
+
+	const unsigned long low = ULONG_MAX / 0xFF;
+	const unsigned long high = low << 7;
+	const unsigned top = PY_DICT_WORD * CHAR_BIT - PY_DICT_WORD;
+	unsigned mask = 0;
+	unsigned i;
+
+	for(i = 0; i < PY_DICT_GROUP; i += PY_DICT_WORD) {
+		unsigned long word = 0, x, match, empty;
+
+		/* The first byte goes lowest. */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		memcpy(&word, ctrl + i, sizeof(word));
+#else
+		unsigned j;
+
+		for(j = PY_DICT_WORD; j--;) word = word << 8 | ctrl[i + j];
+#endif
+
+		x = word ^ (low * tag);
+		match = ~(((x & ~high) + ~high) | x) & high;
+		empty = word & ~(word << 1) & high;
+
+		match = ((match >> 7) * PY_DICT_GATHER) >> top;
+		empty = ((empty >> 7) * PY_DICT_GATHER) >> top;
+
+		mask |= (unsigned) match << i;
+		mask |= (unsigned) empty << (i + PY_DICT_GROUP);
 	}
 
-	if(!(dp = py_object_new(PY_TYPE_DICT))) return 0;
+	return mask;
+}
 
-	dp->size = primes[0];
+#ifdef PY_DICT_SIMD
+__attribute__((target("sse2")))
+static unsigned py_dict_match_sse2(
+		const unsigned char* ctrl, unsigned char tag) {
 
-	if(!(dp->table = calloc(dp->size, sizeof(struct py_dictentry)))) {
-		/* Free instead of decref to avoid trying to free table in dealloc. */
-		free(dp);
-		return 0;
+	__m128i group = _mm_loadu_si128((const __m128i*) ctrl);
+	__m128i tags = _mm_set1_epi8((char) tag);
+	__m128i empty = _mm_set1_epi8((char) PY_DICT_CTRL_EMPTY);
+	unsigned match = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(group, tags));
+
+	empty = _mm_cmpeq_epi8(group, empty);
+
+	return match | (unsigned) _mm_movemask_epi8(empty) << PY_DICT_GROUP;
+}
+
+/* Both halves of one compare: the tag in the low lane, empty in the high. */
+__attribute__((target("avx2")))
+static unsigned py_dict_match_avx2(
+		const unsigned char* ctrl, unsigned char tag) {
+
+	__m128i group = _mm_loadu_si128((const __m128i*) ctrl);
+	__m256i both = _mm256_broadcastsi128_si256(group);
+	__m256i want = _mm256_set_m128i(
+			_mm_set1_epi8((char) PY_DICT_CTRL_EMPTY),
+			_mm_set1_epi8((char) tag));
+
+	return (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(both, want));
+}
+#endif
+
+static unsigned py_dict_match_first(const unsigned char*, unsigned char);
+
+/* TODO: Python global state. */
+static py_dict_match_t* py_dict_match = py_dict_match_first;
+
+/* Settles which way groups are compared on the first use. */
+static unsigned py_dict_match_first(
+		const unsigned char* ctrl, unsigned char tag) {
+
+	py_dict_match = py_dict_match_scalar;
+
+#ifdef PY_DICT_SIMD
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx2")) py_dict_match = py_dict_match_avx2;
+	else if(__builtin_cpu_supports("sse2")) py_dict_match = py_dict_match_sse2;
+#endif
+
+	return py_dict_match(ctrl, tag);
+}
+
+/* The lowest set bit of a nonzero mask. */
+static unsigned py_dict_first(unsigned mask) {
+#ifdef __GNUC__
+	return (unsigned) __builtin_ctz(mask);
+#else
+	unsigned i = 0;
+
+	while(!(mask & 1)) {
+		mask >>= 1;
+		i++;
+	}
+
+	return i;
+#endif
+}
+
+/*
+ * The slots of a grouped table are only read where the control byte says
+ * they hold an entry.
+ */
+static long py_dict_index_get(struct py_dict* dp, unsigned i) {
+	void* index = dp->index;
+
+	if(PY_DICT_IS_GROUPED(dp->size)) {
+		index = py_dict_group(dp, i / PY_DICT_GROUP) + PY_DICT_GROUP;
+		i %= PY_DICT_GROUP;
 	}
 
+	if(dp->size <= 0x80) return ((signed char*) index)[i];
+	if(dp->size <= 0x8000) return ((short*) index)[i];
+
+	return ((int*) index)[i];
+}
+
+/* Points slot `i' at entry `ix' -- or marks it -- for a key of hash `hash'. */
+static void py_dict_slot_set(
+		struct py_dict* dp, unsigned i, long ix, unsigned long hash) {
+
+	void* index = dp->index;
+
+	if(PY_DICT_IS_GROUPED(dp->size)) {
+		unsigned char* group = py_dict_group(dp, i / PY_DICT_GROUP);
+
+		i %= PY_DICT_GROUP;
+		group[i] = ix >= 0 ? PY_DICT_TAG(hash) : PY_DICT_CTRL_DUMMY;
+		index = group + PY_DICT_GROUP;
+	}
+
+	if(dp->size <= 0x80) ((signed char*) index)[i] = (signed char) ix;
+	else if(dp->size <= 0x8000) ((short*) index)[i] = (short) ix;
+	else ((int*) index)[i] = (int) ix;
+}
+
+/* Gives `dp' an empty table of `size' slots. */
+static int py_dict_table_new(struct py_dict* dp, unsigned size) {
+	size_t index = py_dict_index_size(size);
+
+	if(!(dp->index = py_mem_alloc(py_dict_block_size(size)))) return -1;
+
+	/* Every width of PY_DICT_EMPTY is all bits set. */
+	if(!PY_DICT_IS_GROUPED(size)) memset(dp->index, 0xFF, index);
+	else memset(dp->index, PY_DICT_CTRL_EMPTY, index);
+
+	dp->table = (struct py_dictentry*) ((char*) dp->index + index);
+	dp->size = size;
 	dp->fill = 0;
 	dp->used = 0;
 
+	return 0;
+}
+
+/* The smallest table with room for `n' entries, or 0 if there is none. */
+static unsigned py_dict_size_for(unsigned long n) {
+	unsigned size = PY_DICT_MINSIZE;
+
+	while(PY_DICT_USABLE((unsigned long) size) < n) {
+		if(size > UINT_MAX / 2) return 0;
+		size <<= 1;
+	}
+
+	return size;
+}
+
+/*
+ * A dict with room for `n' entries before its table needs rebuilding, for
+ * callers which know how many keys are coming.
+ */
+struct py_object* py_dict_new_sized(unsigned n) {
+	struct py_dict* dp;
+	unsigned size;
+
+	if(!(size = py_dict_size_for(n))) return 0;
+	if(!(dp = py_object_new(PY_TYPE_DICT))) return 0;
+
+	if(py_dict_table_new(dp, size) == -1) {
+		/* Free instead of decref to avoid trying to free table in dealloc. */
+		py_object_delete((void*) dp);
+		return 0;
+	}
+
+	dp->version = ++py_dict_version;
+
 	return (struct py_object*) dp;
 }
 
+struct py_object* py_dict_new(void) {
+	return py_dict_new_sized(0);
+}
+
 /*
- * The basic lookup function used by all operations.
- * This is essentially Algorithm D from Knuth Vol. 3, Sec. 6.4.
- * Open addressing is preferred over chaining since the link overhead for
- * chaining would be substantial (100% with typical malloc overhead).
- *
- * First a 32-bit hash value, 'sum', is computed from the key string.
- * The first character is added an extra time shifted by 8 to avoid hashing
- * single-character keys (often heavily used variables) too close together.
- * All arithmetic on sum should ignore overflow.
- *
- * The initial probe index is then computed as sum mod the table size.
- * Subsequent probe indices are incr apart (mod table size), where incr
- * is also derived from sum, with the additional requirement that it is
- * relative prime to the table size (i.e., 1 <= incr < size, since the size
- * is a prime number). My choice for incr is somewhat arbitrary.
+ * The key being looked for: an object, or -- where the caller has none to
+ * hand -- a string's characters or an int's value, with `op' NULL.
+ */
+struct py_dict_key {
+	enum py_type type;
+	struct py_object* op;
+	const char* str; /* for a string */
+	py_value_t num; /* for an int */
+};
+
+/*
+ * Whether the key of an entry with the same hash -- not the very object
+ * looked for, which is seen to first -- is an equal one. Keys given as an
+ * interned name's characters match without comparing them.
  */
+static int py_dict_key_match(
+		const struct py_object* key, const struct py_dict_key* want) {
 
-static struct py_dictentry* py_dict_look(struct py_dict* dp, const char* key) {
-	unsigned i, incr;
-	unsigned char* p = (unsigned char*) key;
-	unsigned long sum = *p << 7;
+	if(PY_TYPE(key) != want->type) return 0;
 
-	while(*p != '\0') sum = sum + sum + *p++;
+	if(want->type == PY_TYPE_STRING) {
+		const char* str = py_string_get(key);
 
-	i = sum % dp->size;
-	do {
-		sum = sum + sum + 1;
-		incr = sum % dp->size;
-	} while(incr == 0);
+		return str == want->str || !strcmp(str, want->str);
+	}
 
-	for(;;) {
-		struct py_dictentry* ep = &dp->table[i];
-		const char* str;
+	if(want->type == PY_TYPE_INT) return py_int_get(key) == want->num;
+
+	return !py_object_cmp(key, want->op);
+}
+
+/*
+ * Fills in `*want' for the key `key', and `*hash' with its hash, returning
+ * -1 if the key is unhashable. String keys hash from the hash cached with
+ * them.
+ */
+PY_INLINE int py_dict_key_init(
+		struct py_dict_key* want, struct py_object* key, unsigned long* hash) {
+
+	want->type = PY_TYPE(key);
+	want->op = key;
+	want->str = 0;
+	want->num = 0;
+
+	switch(want->type) {
+		default: return py_object_hash(key, hash);
 
-		if(!ep->key) return ep;
+		case PY_TYPE_INT: {
+			want->num = py_int_get(key);
+			*hash = py_int_hash_value(want->num);
 
-		str = py_string_get(ep->key);
+			return 0;
+		}
 
-		if(!strcmp(str, key)) return ep;
+		case PY_TYPE_STRING: {
+			want->str = py_string_get(key);
+			*hash = py_string_hash(key);
 
-		i = (i + incr) % dp->size;
+			return 0;
+		}
 	}
 }
 
 /*
- * Internal routine to insert a new item into the table.
- * Used both by the internal resize routine and by the public insert routine.
- * Eats a reference to key and one to value.
+ * The basic lookup function used by all operations, returning the number of
+ * the entry for `key', or -1 if there is none, and setting `*slot' to the
+ * index slot it was found in. The hash of every key is kept with its entry,
+ * so that only keys with the same hash are compared.
  */
-static void py_dict_table_insert(
-		struct py_dict* dp, struct py_object* key, struct py_object* value) {
+static long py_dict_look_grouped(
+		struct py_dict* dp, const struct py_dict_key* key, unsigned long hash,
+		unsigned* slot) {
 
-	struct py_dictentry* ep;
+	unsigned char tag = PY_DICT_TAG(hash);
+	unsigned groups = dp->size / PY_DICT_GROUP - 1;
+	unsigned g = (unsigned) hash & groups;
+	unsigned step = 0;
+
+	for(;;) {
+		unsigned base = g * PY_DICT_GROUP;
+		unsigned mask = py_dict_match(py_dict_group(dp, g), tag);
+		unsigned match = mask & ((1U << PY_DICT_GROUP) - 1);
 
-	ep = py_dict_look(dp, py_string_get(key));
+		for(; match; match &= match - 1) {
+			unsigned i = base + py_dict_first(match);
+			long ix = py_dict_index_get(dp, i);
+			struct py_dictentry* ep = &dp->table[ix];
 
-	if(ep->value) {
-		py_object_decref(ep->value);
-		py_object_decref(key);
+			if(ep->hash == hash &&
+				(ep->key == key->op || py_dict_key_match(ep->key, key))) {
+
+				*slot = i;
+				return ix;
+			}
+		}
+
+		if(mask >> PY_DICT_GROUP) return -1;
+
+		g = (g + ++step) & groups;
+	}
+}
+
+static long py_dict_look(
+		struct py_dict* dp, const struct py_dict_key* key, unsigned long hash,
+		unsigned* slot) {
+
+	unsigned long perturb = hash;
+	unsigned mask = dp->size - 1;
+	unsigned i = (unsigned) hash & mask;
+
+	if(PY_DICT_IS_GROUPED(dp->size)) {
+		return py_dict_look_grouped(dp, key, hash, slot);
+	}
+
+	for(;;) {
+		long ix = py_dict_index_get(dp, i);
+
+		if(ix == PY_DICT_EMPTY) return -1;
+
+		if(ix >= 0) {
+			struct py_dictentry* ep = &dp->table[ix];
+
+			if(ep->hash == hash &&
+				(ep->key == key->op || py_dict_key_match(ep->key, key))) {
+
+				*slot = i;
+				return ix;
+			}
+		}
+
+		perturb >>= PY_DICT_PERTURB_SHIFT;
+		i = (unsigned) (i * 5 + perturb + 1) & mask;
+	}
+}
+
+/* Finds the first empty index slot along the probe sequence of `hash'. */
+static unsigned py_dict_look_empty(struct py_dict* dp, unsigned long hash) {
+	unsigned long perturb = hash;
+	unsigned mask = dp->size - 1;
+	unsigned i = (unsigned) hash & mask;
+
+	if(PY_DICT_IS_GROUPED(dp->size)) {
+		unsigned groups = dp->size / PY_DICT_GROUP - 1;
+		unsigned g = (unsigned) hash & groups;
+		unsigned step = 0;
+
+		for(;;) {
+			/* Only the empty half of the mask is wanted. */
+			unsigned empty = py_dict_match(py_dict_group(dp, g), 0);
+
+			empty >>= PY_DICT_GROUP;
+			if(empty) return g * PY_DICT_GROUP + py_dict_first(empty);
+
+			g = (g + ++step) & groups;
+		}
 	}
-	else {
-		if(ep->key == NULL) dp->fill++;
-		else py_object_decref(ep->key);
 
-		ep->key = key;
-		dp->used++;
+	while(py_dict_index_get(dp, i) != PY_DICT_EMPTY) {
+		perturb >>= PY_DICT_PERTURB_SHIFT;
+		i = (unsigned) (i * 5 + perturb + 1) & mask;
 	}
 
-	ep->value = value;
+	return i;
+}
+
+static long py_dict_look_string(
+		struct py_dict* dp, const char* key, unsigned* slot) {
+
+	struct py_dict_key want = { PY_TYPE_STRING, 0, 0, 0 };
+	unsigned long hash = py_string_hash_size(key, (unsigned) strlen(key));
+
+	want.str = key;
+
+	return py_dict_look(dp, &want, hash, slot);
+}
+
+/* Unhashable keys are in no dict. */
+PY_INLINE long py_dict_look_object(
+		struct py_dict* dp, struct py_object* key, unsigned* slot) {
+
+	struct py_dict_key want;
+	unsigned long hash;
+
+	if(py_dict_key_init(&want, key, &hash) == -1) return -1;
+
+	return py_dict_look(dp, &want, hash, slot);
 }
 
 /*
- * Restructure the table by allocating a new table and reinserting all
- * items again. When entries have been deleted, the new table may
- * actually be smaller than the old one.
+ * Rebuilds the table with room for `want' entries, copying the entries in
+ * use across in order. Their keys are known to differ, so each goes in the
+ * first empty slot along its probe sequence -- found from the stored hash
+ * without looking at the key itself.
  */
-static int py_dict_resize(struct py_dict* dp) {
-	unsigned oldsize = dp->size;
+static int py_dict_resize(struct py_dict* dp, unsigned long want) {
+	struct py_dict old = *dp;
 	unsigned newsize;
-	struct py_dictentry* oldtable = dp->table;
-	struct py_dictentry* newtable;
-	struct py_dictentry* ep;
-	unsigned i;
+	unsigned i, slot;
 
-	for(i = 0;; i++) {
-		if(primes[i] > (unsigned) (dp->used * 2)) {
-			newsize = primes[i];
-			break;
-		}
+	if(!(newsize = py_dict_size_for(want))) return -1;
+
+	if(py_dict_table_new(dp, newsize) == -1) {
+		*dp = old;
+		return -1;
 	}
 
-	if(!(newtable = calloc(newsize, sizeof(struct py_dictentry)))) return -1;
+	for(i = 0; i < old.fill; i++) {
+		struct py_dictentry* ep = &old.table[i];
 
-	dp->size = newsize;
-	dp->table = newtable;
-	dp->fill = 0;
-	dp->used = 0;
+		if(!ep->value) continue;
 
-	for(i = 0, ep = oldtable; i < oldsize; i++, ep++) {
-		if(ep->value) py_dict_table_insert(dp, ep->key, ep->value);
-		else if(ep->key) py_object_decref(ep->key);
+		slot = py_dict_look_empty(dp, ep->hash);
+		py_dict_slot_set(dp, slot, dp->fill, ep->hash);
+		dp->table[dp->fill++] = *ep;
 	}
 
-	free(oldtable);
+	dp->used = dp->fill;
+	dp->version = ++py_dict_version;
+
+	py_mem_free(old.index, py_dict_block_size(old.size));
+
 	return 0;
 }
 
 struct py_object* py_dict_lookup(struct py_object* op, const char* key) {
-	return py_dict_look((void*) op, key)->value;
+	struct py_dict* dp = (struct py_dict*) op;
+	unsigned slot;
+	long ix = py_dict_look_string(dp, key, &slot);
+
+	return ix < 0 ? 0 : dp->table[ix].value;
+}
+
+/*
+ * Looks up an int key by its value, with no int object made to look it up
+ * with. The value returned is borrowed.
+ */
+struct py_object* py_dict_lookup_int(struct py_object* op, py_value_t key) {
+	struct py_dict* dp = (struct py_dict*) op;
+	struct py_dict_key want = { PY_TYPE_INT, 0, 0, 0 };
+	unsigned slot;
+	long ix;
+
+	want.num = key;
+	ix = py_dict_look(dp, &want, py_int_hash_value(key), &slot);
+
+	return ix < 0 ? 0 : dp->table[ix].value;
+}
+
+/* Returns the entry holding the key `key', or NULL if there is none. */
+struct py_dictentry* py_dict_lookup_entry(
+		struct py_object* op, struct py_object* key) {
+
+	struct py_dict* dp = (struct py_dict*) op;
+	unsigned slot;
+	long ix = py_dict_look_object(dp, key, &slot);
+
+	return ix < 0 ? 0 : &dp->table[ix];
 }
 
 static int py_dict_insert_impl(
 		struct py_object* op, struct py_object* key, struct py_object* value) {
 
 	struct py_dict* dp;
-	struct py_object* keyobj;
+	struct py_dictentry* ep;
+	struct py_dict_key want;
+	unsigned long hash;
+	unsigned slot;
+	long ix;
 
 	/* TODO: Non-typechecked builds. */
-	if(op->type != PY_TYPE_DICT) return -1;
+	if(PY_TYPE(op) != PY_TYPE_DICT) return -1;
 
 	dp = (struct py_dict*) op;
-	if(key->type != PY_TYPE_STRING) return -1;
+	if(py_dict_key_init(&want, key, &hash) == -1) return -1;
 
-	keyobj = key;
+	if((ix = py_dict_look(dp, &want, hash, &slot)) >= 0) {
+		ep = &dp->table[ix];
 
-	/* if fill >= 2/3 size, resize */
-	if(dp->fill * 3 >= dp->size * 2) {
-		if(py_dict_resize(dp) != 0) {
-			if(dp->fill + 1 > dp->size) return -1;
-		}
+		py_object_incref(value);
+		py_object_decref(ep->value);
+		ep->value = value;
+
+		return 0;
 	}
 
-	py_object_incref(keyobj);
-	py_object_incref(value);
-	py_dict_table_insert(dp, keyobj, value);
+	/* Grown to twice the keys in use, so that growing stays linear. */
+	if(dp->fill == PY_DICT_USABLE(dp->size)) {
+		unsigned long want = (unsigned long) dp->used * 2 + 1;
+
+		if(py_dict_resize(dp, want) == -1) return -1;
+	}
+
+	py_dict_slot_set(dp, py_dict_look_empty(dp, hash), dp->fill, hash);
+
+	ep = &dp->table[dp->fill++];
+	ep->key = py_object_incref(key);
+	ep->value = py_object_incref(value);
+	ep->hash = hash;
+
+	dp->used++;
+	dp->version = ++py_dict_version;
 
 	return 0;
 }
@@ -223,7 +646,7 @@ int py_dict_insert(
 	struct py_object* keyobj;
 	int err;
 
-	if(!(keyobj = py_string_new(key))) return -1;
+	if(!(keyobj = py_string_intern(key))) return -1;
 
 	err = py_dict_insert_impl(op, keyobj, value);
 	py_object_decref(keyobj);
@@ -231,34 +654,84 @@ int py_dict_insert(
 	return err;
 }
 
-int py_dict_remove(struct py_object* op, const char* key) {
-	struct py_dict* dp;
-	struct py_dictentry* ep;
+/*
+ * Makes room for `n' more entries, so that inserting up to that many keys
+ * won't rebuild the table. A table without the room is rebuilt once, to fit
+ * the keys in use and the `n' more exactly.
+ */
+int py_dict_reserve(struct py_object* op, unsigned n) {
+	struct py_dict* dp = (struct py_dict*) op;
 
-	dp = (struct py_dict*) op;
-	ep = py_dict_look(dp, key);
+	/* TODO: Non-typechecked builds. */
+	if(PY_TYPE(op) != PY_TYPE_DICT) return -1;
 
-	if(!ep->value) return -1;
+	if((unsigned long) dp->fill + n <= PY_DICT_USABLE(dp->size)) return 0;
 
-	py_object_decref(ep->key);
+	return py_dict_resize(dp, (unsigned long) dp->used + n);
+}
 
-	ep->key = py_object_incref(dummy);
+/*
+ * Inserts `n' keys with their values, making room for all of them first.
+ * Stops at the first key which can't be inserted.
+ */
+int py_dict_insert_many(
+		struct py_object* op, struct py_object** keys,
+		struct py_object** values, unsigned n) {
+
+	unsigned i;
+
+	if(py_dict_reserve(op, n) == -1) return -1;
 
+	for(i = 0; i < n; i++) {
+		if(py_dict_insert_impl(op, keys[i], values[i]) == -1) return -1;
+	}
+
+	return 0;
+}
+
+static int py_dict_remove_entry(struct py_dict* dp, long ix, unsigned slot) {
+	struct py_dictentry* ep;
+
+	if(ix < 0) return -1;
+
+	ep = &dp->table[ix];
+
+	py_dict_slot_set(dp, slot, PY_DICT_DUMMY, ep->hash);
+
+	py_object_decref(ep->key);
 	py_object_decref(ep->value);
 
+	ep->key = 0;
 	ep->value = 0;
 	dp->used--;
+	dp->version = ++py_dict_version;
 
 	return 0;
 }
 
+int py_dict_remove(struct py_object* op, const char* key) {
+	struct py_dict* dp = (struct py_dict*) op;
+	unsigned slot;
+	long ix = py_dict_look_string(dp, key, &slot);
+
+	return py_dict_remove_entry(dp, ix, slot);
+}
+
 static int py_dict_remove_impl(struct py_object* op, struct py_object* key) {
-	return py_dict_remove(op, py_string_get(key));
+	struct py_dict* dp = (struct py_dict*) op;
+	unsigned slot;
+	long ix = py_dict_look_object(dp, key, &slot);
+
+	return py_dict_remove_entry(dp, ix, slot);
 }
 
+/*
+ * The number of entries, to go through with `py_dict_get_key' -- cleared
+ * ones included, for which it gives NULL.
+ */
 /* TODO: Dicts as varobjects? */
 unsigned py_dict_size(struct py_object* op) {
-	return ((struct py_dict*) op)->size;
+	return ((struct py_dict*) op)->fill;
 }
 
 static struct py_object* py_dict_get_key_impl(
@@ -272,10 +745,12 @@ static struct py_object* py_dict_get_key_impl(
 	return (void*) dp->table[i].key;
 }
 
+/* Keys other than strings are given as NULL too. */
 const char* py_dict_get_key(struct py_object* op, unsigned i) {
 	struct py_object* key;
 
 	if(!(key = py_dict_get_key_impl(op, i))) return 0;
+	if(PY_TYPE(key) != PY_TYPE_STRING) return 0;
 
 	return py_string_get(key);
 }
@@ -287,24 +762,38 @@ void py_dict_dealloc(struct py_object* op) {
 	struct py_dictentry* ep;
 	unsigned i;
 
-	for(i = 0, ep = dp->table; i < dp->size; i++, ep++) {
-		if(ep->key) py_object_decref(ep->key);
-		if(ep->value) py_object_decref(ep->value);
+	for(i = 0, ep = dp->table; i < dp->fill; i++, ep++) {
+		py_object_decref(ep->key);
+		py_object_decref(ep->value);
 	}
 
-	if(dp->table) free(dp->table);
+	py_mem_free(dp->index, py_dict_block_size(dp->size));
 
-	free(op);
+	py_object_delete(op);
 }
 
-struct py_object* py_dict_lookup_object(
-		struct py_object* dp, struct py_object* v) {
+/*
+ * Keys are strings, numbers or tuples of them, which can't refer back to
+ * anything -- only values count.
+ */
+void py_dict_traverse(struct py_object* op, py_visit_t visit, void* arg) {
+	struct py_dict* dp = (struct py_dict*) op;
+	struct py_dictentry* ep;
+	unsigned i;
 
-	if(!(v = py_dict_look((struct py_dict*) dp, py_string_get(v))->value)) {
-		return 0;
+	for(i = 0, ep = dp->table; i < dp->fill; i++, ep++) {
+		if(ep->value) visit(&ep->value, arg);
 	}
+}
+
+struct py_object* py_dict_lookup_object(
+		struct py_object* op, struct py_object* v) {
+
+	struct py_dict* dp = (struct py_dict*) op;
+	unsigned slot;
+	long ix = py_dict_look_object(dp, v, &slot);
 
-	return py_object_incref(v);
+	return ix < 0 ? 0 : py_object_incref(dp->table[ix].value);
 }
 
 int py_dict_assign(
@@ -315,6 +804,6 @@ int py_dict_assign(
 	return py_dict_insert_impl((void*) dp, v, w);
 }
 
+/* Removed keys need no dummy any more -- nothing is left to release. */
 void py_done_dict(void) {
-	py_object_decref(dummy);
 }
@@ -7,10 +7,29 @@
 
 #include <python/object/float.h>
 
+/*
+ * Arithmetic makes and drops floats constantly, so released ones are kept
+ * on a free list of their own (up to a limit) and reused before going back
+ * to the allocator.
+ */
+
+#define PY_FLOAT_KEEP (256) /* Floats kept on the free list */
+
+/* TODO: Python global state. */
+static struct py_float* py_float_freelist = 0;
+static unsigned py_float_freecount = 0;
+
 struct py_object* py_float_new(double value) {
 	struct py_float* op;
 
-	if(!(op = py_object_new(PY_TYPE_FLOAT))) return 0;
+	if((op = py_float_freelist)) {
+		py_float_freelist = *(struct py_float**) op;
+		py_float_freecount--;
+
+		py_object_newref(op);
+		op->ob.type = PY_TYPE_FLOAT;
+	}
+	else if(!(op = py_object_new(PY_TYPE_FLOAT))) return 0;
 
 	op->value = value;
 
@@ -18,7 +37,23 @@ struct py_object* py_float_new(double value) {
 }
 
 void py_float_dealloc(struct py_object* op) {
-	free(op);
+	if(py_float_freecount < PY_FLOAT_KEEP) {
+		*(struct py_float**) op = py_float_freelist;
+		py_float_freelist = (void*) op;
+		py_float_freecount++;
+	}
+	else py_object_delete(op);
+}
+
+void py_float_done(void) {
+	while(py_float_freelist) {
+		struct py_float* op = py_float_freelist;
+
+		py_float_freelist = *(struct py_float**) op;
+		py_object_delete((void*) op);
+	}
+
+	py_float_freecount = 0;
 }
 
 double py_float_get(const struct py_object* op) {
@@ -33,3 +68,26 @@ int py_float_cmp(const struct py_object* v, const struct py_object* w) {
 
 	return (i < j) ? -1 : (i > j) ? 1 : 0;
 }
+
+#define PY_FLOAT_WORDS \
+		((sizeof(double) + sizeof(unsigned long) - 1) / sizeof(unsigned long))
+
+/*
+ * Equal floats hash alike, 0.0 and -0.0 included. The bits of the value are
+ * folded a word at a time, then the high half of the word into the low.
+ */
+unsigned long py_float_hash(struct py_object* op) {
+	double value = py_float_get(op);
+	unsigned long words[PY_FLOAT_WORDS];
+	unsigned long hash = 0;
+	unsigned i;
+
+	if(value == 0.0) value = 0.0;
+	memset(words, 0, sizeof(words));
+	memcpy(words, &value, sizeof(value));
+
+	for(i = 0; i < PY_FLOAT_WORDS; ++i) hash ^= words[i];
+	hash ^= hash >> (sizeof(hash) * CHAR_BIT / 2);
+
+	return hash * PY_HASH_MULTIPLIER;
+}
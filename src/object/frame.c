@@ -6,42 +6,93 @@
 /* Frame object implementation */
 
 #include <python/std.h>
+#include <python/gc.h>
 #include <python/compile.h>
+#include <python/errors.h>
 #include <python/opcode.h>
 
 #include <python/object/frame.h>
 #include <python/object/dict.h>
+#include <python/object/list.h>
+#include <python/object/string.h>
+
+/*
+ * A frame and its slot, value and block stacks are one allocation. Released
+ * frames are kept on freelists bucketed by that allocation's size, so that
+ * in the steady state a call and return touches no heap at all. Frames
+ * larger than the biggest bucket go straight back to the allocator, as do
+ * frames beyond a bucket's limit -- a deep recursion doesn't pin its peak
+ * forever.
+ */
+
+#define PY_FRAME_GRAIN (64) /* Bucket granularity in bytes */
+#define PY_FRAME_BUCKETS (64) /* Buckets cover frames up to 4K */
+#define PY_FRAME_KEEP (32) /* Frames kept per bucket */
+
+/* TODO: Python global state. */
+static struct py_frame* py_frame_freelist[PY_FRAME_BUCKETS];
+static unsigned py_frame_freecount[PY_FRAME_BUCKETS];
 
 struct py_frame* py_frame_new(
 		struct py_frame* back, struct py_code* code, struct py_object* globals,
 		struct py_object* locals, unsigned nvalues, unsigned nblocks) {
 
 	struct py_frame* f;
+	unsigned nfast = code->fast ? py_varobject_size(code->names) : 0;
+	unsigned bucket;
+	size_t size;
+
+	size = sizeof(struct py_frame);
+	size += (nfast + nvalues + 1) * sizeof(struct py_object*);
+	size += (nblocks + 1) * sizeof(struct py_block);
 
-	if(!(f = py_object_new(PY_TYPE_FRAME))) return 0;
+	bucket = (unsigned) ((size + PY_FRAME_GRAIN - 1) / PY_FRAME_GRAIN);
+
+	if(bucket < PY_FRAME_BUCKETS && (f = py_frame_freelist[bucket])) {
+		py_frame_freelist[bucket] = *(struct py_frame**) f;
+		py_frame_freecount[bucket]--;
+	}
+	else {
+		if(bucket < PY_FRAME_BUCKETS) size = bucket * PY_FRAME_GRAIN;
+		if(!(f = py_gc_alloc(size))) {
+			py_error_set_nomem();
+			return 0;
+		}
+	}
+
+	py_object_newref(f);
+	f->ob.type = PY_TYPE_FRAME;
+	f->bucket = bucket;
+	py_gc_track(f);
 
 	f->back = py_object_incref(back);
 	f->code = py_object_incref(code);
 	f->globals = py_object_incref(globals);
 	f->locals = py_object_incref(locals);
 
-	if(!(f->valuestack = calloc(nvalues + 1, sizeof(struct py_object*)))) {
-		goto cleanup;
-	}
+	f->valuestack = (struct py_object**) (f + 1);
+	f->fastlocals = 0;
+
+	if(nfast) {
+		f->fastlocals = f->valuestack;
+		f->valuestack += nfast;
 
-	if(!(f->blockstack = calloc(nblocks + 1, sizeof(struct py_block)))) {
-		goto cleanup;
+		memset(f->fastlocals, 0, nfast * sizeof(struct py_object*));
 	}
 
+	f->blockstack = (struct py_block*) (f->valuestack + nvalues + 1);
 	f->nblocks = nblocks;
 	f->iblock = 0;
 
 	return f;
+}
 
-	cleanup: {
-		py_object_decref(f);
-		return 0;
-	}
+/*
+ * The size a frame's memory was allocated with. Frames beyond the buckets
+ * are over PY_MEM_MAX, where the exact size doesn't matter to `py_gc_free'.
+ */
+static size_t py_frame_size(struct py_frame* f) {
+	return f->bucket * PY_FRAME_GRAIN;
 }
 
 /* Block management */
@@ -55,22 +106,97 @@ void py_block_setup(
 	b->type = type;
 	b->level = level;
 	b->handler = handler;
+	b->index = 0;
 }
 
 struct py_block* py_block_pop(struct py_frame* f) {
 	return &f->blockstack[--f->iblock];
 }
 
+/*
+ * Returns the locals dict of a frame, borrowed. For a frame whose locals live
+ * in slots this is built on first use and brought up to date on every call --
+ * stores made to it are not seen by the frame.
+ */
+struct py_object* py_frame_get_locals(struct py_frame* f) {
+	struct py_object* names = f->code->names;
+	unsigned i, n;
+
+	if(!f->fastlocals) return f->locals;
+
+	if(!f->locals && !(f->locals = py_dict_new())) return 0;
+
+	n = py_varobject_size(names);
+	for(i = 0; i < n; i++) {
+		struct py_object* v = f->fastlocals[i];
+		struct py_object* name = py_list_get(names, i);
+
+		if(v) {
+			if(py_dict_assign(f->locals, name, v) == -1) return 0;
+		}
+		else py_dict_assign(f->locals, name, 0);
+	}
+
+	return f->locals;
+}
+
 void py_frame_dealloc(struct py_object* op) {
 	struct py_frame* f = (void*) op;
 
 	py_object_decref(f->back);
-	py_object_decref(f->code);
 	py_object_decref(f->globals);
 	py_object_decref(f->locals);
 
-	free(f->valuestack);
-	free(f->blockstack);
+	if(f->fastlocals) {
+		unsigned i, n = py_varobject_size(f->code->names);
+
+		for(i = 0; i < n; i++) py_object_decref(f->fastlocals[i]);
+	}
+
+	/* Released last -- `f->code' is needed above. */
+	py_object_decref(f->code);
+
+	py_gc_untrack(f);
+
+	if(f->bucket < PY_FRAME_BUCKETS &&
+		py_frame_freecount[f->bucket] < PY_FRAME_KEEP) {
+
+		*(struct py_frame**) f = py_frame_freelist[f->bucket];
+		py_frame_freelist[f->bucket] = f;
+		py_frame_freecount[f->bucket]++;
+	}
+	else py_gc_free(f, py_frame_size(f));
+}
+
+/*
+ * The code is left out -- it can't refer back to the frame, and is needed to
+ * find the slots.
+ */
+void py_frame_traverse(struct py_object* op, py_visit_t visit, void* arg) {
+	struct py_frame* f = (void*) op;
+
+	visit((struct py_object**) &f->back, arg);
+	visit(&f->globals, arg);
+	visit(&f->locals, arg);
+
+	if(f->fastlocals) {
+		unsigned i, n = py_varobject_size(f->code->names);
+
+		for(i = 0; i < n; i++) visit(&f->fastlocals[i], arg);
+	}
+}
+
+void py_frame_done(void) {
+	unsigned i;
 
-	free(op);
+	for(i = 0; i < PY_FRAME_BUCKETS; i++) {
+		while(py_frame_freelist[i]) {
+			struct py_frame* f = py_frame_freelist[i];
+
+			py_frame_freelist[i] = *(struct py_frame**) f;
+			py_gc_free(f, py_frame_size(f));
+		}
+
+		py_frame_freecount[i] = 0;
+	}
 }
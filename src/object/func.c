@@ -29,5 +29,12 @@ void py_func_dealloc(struct py_object* op) {
 	py_object_decref(fp->code);
 	py_object_decref(fp->globals);
 
-	free(op);
+	py_object_delete(op);
+}
+
+void py_func_traverse(struct py_object* op, py_visit_t visit, void* arg) {
+	struct py_func* fp = (void*) op;
+
+	visit(&fp->code, arg);
+	visit(&fp->globals, arg);
 }
@@ -11,67 +11,74 @@
 #include <python/object/string.h>
 
 /* Standard Booleans */
-struct py_int py_true_object = { { PY_TYPE_INT, 1 }, 1 };
-struct py_int py_false_object = { { PY_TYPE_INT, 1 }, 0 };
+struct py_int py_true_object = { { PY_TYPE_INT, PY_REFCOUNT_IMMORTAL }, 1 };
+struct py_int py_false_object = { { PY_TYPE_INT, PY_REFCOUNT_IMMORTAL }, 0 };
 
-/* TODO: Use "weird pointers" for integers. */
 /*
  * Integers are quite normal objects, to make object handling uniform.
  * (Using odd pointers to represent integers would save much space
- * but require extra checks for this special case throughout the code.)
+ * but require extra checks for this special case throughout the code --
+ * builds with PY_TAGGED_INT pay for those checks and do so.)
  * Since, a typical Python program spends much of its time allocating
  * and deallocating integers, these operations should be very fast.
- * Therefore we use a dedicated allocation scheme with a much lower
- * overhead (in space and time) than straight malloc(): a simple
- * dedicated free list, filled when necessary with memory from malloc().
+ * They come from the small-object pools like everything else, which cost
+ * about as little as a dedicated free list would.
  */
 
-#define PY_INT_BLOCK_SIZE (1024) /* 1K less typical malloc overhead */
-#define PY_INT_COUNT (PY_INT_BLOCK_SIZE / sizeof(struct py_int))
-
+#ifndef PY_TAGGED_INT
 /* TODO: Python global state. */
-static struct py_int* py_int_freelist = NULL;
-
-static enum py_result py_int_freelist_fill(void) {
-	struct py_int* p;
-	struct py_int* q;
-
-	if(!(p = calloc(PY_INT_COUNT, sizeof(struct py_int)))) {
-		return PY_RESULT_OOM;
-	}
+static struct py_int py_int_small[PY_INT_SMALL_MAX - PY_INT_SMALL_MIN + 1];
+#endif
 
-	q = p + PY_INT_COUNT;
+#ifdef PY_REF_DEBUG
+long py_int_alloc_total = 0;
+#endif
 
-	while(--q > p) *(struct py_int**) q = q - 1;
+void py_int_init(void) {
+#ifndef PY_TAGGED_INT
+	unsigned i;
 
-	*(struct py_int**) q = 0;
-
-	py_int_freelist = p + PY_INT_COUNT - 1;
-
-	return PY_RESULT_OK;
+	for(i = 0; i < PY_INT_SMALL_MAX - PY_INT_SMALL_MIN + 1; i++) {
+		py_int_small[i].ob.refcount = PY_REFCOUNT_IMMORTAL;
+		py_int_small[i].ob.type = PY_TYPE_INT;
+		py_int_small[i].value = PY_INT_SMALL_MIN + (py_value_t) i;
+	}
+#endif
 }
 
 struct py_object* py_int_new(py_value_t value) {
 	struct py_int* v;
 
-	if(!py_int_freelist && (py_int_freelist_fill() != PY_RESULT_OK)) return 0;
+#ifdef PY_TAGGED_INT
+	if(value >= PY_INT_TAGGED_MIN && value <= PY_INT_TAGGED_MAX) {
+		return PY_INT_TAG(value);
+	}
+#else
+	if(value >= PY_INT_SMALL_MIN && value <= PY_INT_SMALL_MAX) {
+		return (void*) &py_int_small[value - PY_INT_SMALL_MIN];
+	}
+#endif
+
+	if(!(v = py_object_new(PY_TYPE_INT))) return 0;
 
-	v = py_int_freelist;
-	py_int_freelist = *(struct py_int**) py_int_freelist;
-	py_object_newref(v);
+#ifdef PY_REF_DEBUG
+	py_int_alloc_total++;
+#endif
 
-	v->ob.type = PY_TYPE_INT;
 	v->value = value;
 
 	return (void*) v;
 }
 
 void py_int_dealloc(struct py_object* op) {
-	*(struct py_int**) op = py_int_freelist;
-	py_int_freelist = (void*) op;
+	py_object_delete(op);
 }
 
 py_value_t py_int_get(const struct py_object* op) {
+#ifdef PY_TAGGED_INT
+	if(PY_IS_TAGGED(op)) return PY_INT_UNTAG(op);
+#endif
+
 	return ((struct py_int*) op)->value;
 }
 
@@ -83,3 +90,7 @@ int py_int_cmp(const struct py_object* v, const struct py_object* w) {
 
 	return (i < j) ? -1 : (i > j) ? 1 : 0;
 }
+
+unsigned long py_int_hash(struct py_object* op) {
+	return py_int_hash_value(py_int_get(op));
+}
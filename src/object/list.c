@@ -12,11 +12,12 @@
 struct py_object* py_list_new(unsigned size) {
 	struct py_list* op;
 
+	if(size > PY_VAROBJECT_MAX) return 0;
 	if(!(op = py_object_new(PY_TYPE_LIST))) return 0;
 	op->ob.size = size;
 
 	if(!(op->item = calloc(size, sizeof(struct py_object*)))) {
-		free(op);
+		py_object_delete((void*) op);
 		return 0;
 	}
 
@@ -42,6 +43,8 @@ static int py_list_insert_impl(
 
 	struct py_object** items;
 
+	if(self->ob.size == PY_VAROBJECT_MAX) return -1;
+
 	/* This isn't leaky -- we want to preserve original in OOM case here. */
 	items = realloc(self->item, (self->ob.size + 1) * sizeof(struct py_object*));
 	if(!items) return -1;
@@ -79,7 +82,14 @@ void py_list_dealloc(struct py_object* op) {
 
 	free(lp->item);
 
-	free(op);
+	py_object_delete(op);
+}
+
+void py_list_traverse(struct py_object* op, py_visit_t visit, void* arg) {
+	unsigned i;
+	struct py_list* lp = (void*) op;
+
+	for(i = 0; i < lp->ob.size; i++) visit(&lp->item[i], arg);
 }
 
 int py_list_cmp(const struct py_object* v, const struct py_object* w) {
@@ -23,5 +23,9 @@ struct py_object* py_method_new(py_method_t method, struct py_object* self) {
 void py_method_dealloc(struct py_object* op) {
 	py_object_decref(((struct py_method*) op)->self);
 
-	free(op);
+	py_object_delete(op);
+}
+
+void py_method_traverse(struct py_object* op, py_visit_t visit, void* arg) {
+	visit(&((struct py_method*) op)->self, arg);
 }
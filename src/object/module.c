@@ -43,17 +43,22 @@ struct py_object* py_module_new_methods(
 	struct py_object* m;
 	struct py_object* d;
 	struct py_object* v;
+	unsigned n;
 
 	if(!(m = py_module_add(env, name))) return 0;
 
 	d = ((struct py_module*) m)->attr;
 
+	for(n = 0; methods[n].name; n++) continue;
+	if(py_dict_reserve(d, n) == -1) return 0;
+
 	for(; methods->name; methods++) {
 		v = py_method_new(methods->method, (struct py_object*) NULL);
 
 		if(!v || py_dict_insert(d, methods->name, v) == -1) return 0;
 
-		py_object_decref(v);
+		/* Builtin methods are called constantly and never go away. */
+		py_object_immortalise(v);
 	}
 
 	return m;
@@ -67,15 +72,25 @@ void py_module_dealloc(struct py_object* op) {
 	py_object_decref(m->name);
 	py_object_decref(m->attr);
 
-	free(op);
+	py_object_delete(op);
+}
+
+void py_module_traverse(struct py_object* op, py_visit_t visit, void* arg) {
+	struct py_module* m = (void*) op;
+
+	visit(&m->name, arg);
+	visit(&m->attr, arg);
 }
 
-struct py_object* py_module_get_attr(struct py_object* op, const char* name) {
+struct py_object* py_module_get_attr(
+		struct py_object* op, struct py_object* name) {
+
 	struct py_module* m = (void*) op;
+	const char* str = py_string_get(name);
 
 	/* TODO: Remove. */
-	if(!strcmp(name, "__dict__")) return py_object_incref(m->attr);
-	if(!strcmp(name, "__name__")) return py_object_incref(m->name);
+	if(!strcmp(str, "__dict__")) return py_object_incref(m->attr);
+	if(!strcmp(str, "__name__")) return py_object_incref(m->name);
 
-	return py_object_incref(py_dict_lookup(m->attr, name));
+	return py_dict_lookup_object(m->attr, name);
 }
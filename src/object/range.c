@@ -0,0 +1,76 @@
+/*
+ * Copyright 1991 by Stichting Mathematisch Centrum
+ * See `LICENCE' for more information.
+ */
+
+/* Range object implementation */
+
+#include <python/std.h>
+#include <python/errors.h>
+
+#include <python/object/range.h>
+
+struct py_object* py_range_new(py_value_t start, py_value_t step, unsigned n) {
+	struct py_range* op;
+
+	if(!(op = py_object_new(PY_TYPE_RANGE))) return 0;
+
+	op->length = n;
+	op->start = start;
+	op->step = step;
+
+	return (void*) op;
+}
+
+py_value_t py_range_get(const struct py_object* op, unsigned i) {
+	const struct py_range* rp = (const void*) op;
+
+	return rp->start + (py_value_t) i * rp->step;
+}
+
+/* Methods */
+
+void py_range_dealloc(struct py_object* op) {
+	py_object_delete(op);
+}
+
+int py_range_cmp(const struct py_object* v, const struct py_object* w) {
+	unsigned a, b;
+	unsigned len;
+	unsigned i;
+
+	a = py_varobject_size(v);
+	b = py_varobject_size(w);
+	len = (a < b) ? a : b;
+
+	for(i = 0; i < len; i++) {
+		py_value_t x = py_range_get(v, i);
+		py_value_t y = py_range_get(w, i);
+
+		if(x != y) return (x < y) ? -1 : 1;
+	}
+
+	return (int) (a - b);
+}
+
+struct py_object* py_range_ind(struct py_object* op, unsigned i) {
+	struct py_object* v;
+
+	if(!(v = py_int_new(py_range_get(op, i)))) py_error_set_nomem();
+
+	return v;
+}
+
+/* A slice of a range is a range over the same step. */
+struct py_object* py_range_slice(
+		struct py_object* op, unsigned low, unsigned high) {
+
+	struct py_range* rp = (void*) op;
+
+	if(low > py_varobject_size(op)) low = py_varobject_size(op);
+
+	if(high < low) high = low;
+	else if(high > py_varobject_size(op)) high = py_varobject_size(op);
+
+	return py_range_new(py_range_get(op, low), rp->step, high - low);
+}
@@ -9,18 +9,98 @@
 
 #include <python/object/string.h>
 
+/*
+ * Interned strings are kept in an open-addressed table whose size is a power
+ * of two, probed linearly and kept under two-thirds full. The table holds a
+ * reference to each of its strings, so one interned string stays the same
+ * object for as long as the table lives -- names which are interned wherever
+ * they are made can then be told apart by pointer.
+ */
+
+#define PY_STRING_INTERN_MIN (256)
+
+/* TODO: Python global state. */
+static struct py_object** py_string_interned;
+static unsigned py_string_interned_size;
+static unsigned py_string_interned_used;
+
+/*
+ * Returns the slot holding the interned string equal to `str', or the empty
+ * slot where it would go.
+ */
+static struct py_object** py_string_intern_look(
+		const char* str, unsigned size, unsigned long hash) {
+
+	unsigned mask = py_string_interned_size - 1;
+	unsigned i = (unsigned) hash & mask;
+
+	for(;; i = (i + 1) & mask) {
+		struct py_object** slot = &py_string_interned[i];
+		struct py_object* op = *slot;
+
+		if(!op) return slot;
+
+		if(py_string_hash(op) == hash &&
+			py_varobject_size(op) == size &&
+			!memcmp(py_string_get(op), str, size)) {
+
+			return slot;
+		}
+	}
+}
+
+static int py_string_intern_grow(void) {
+	struct py_object** old = py_string_interned;
+	unsigned oldsize = py_string_interned_size;
+	unsigned size = oldsize ? oldsize * 2 : PY_STRING_INTERN_MIN;
+	unsigned i;
+
+	if(!(py_string_interned = calloc(size, sizeof(struct py_object*)))) {
+		py_string_interned = old;
+		return -1;
+	}
+
+	py_string_interned_size = size;
+
+	for(i = 0; i < oldsize; i++) {
+		struct py_object* op = old[i];
+
+		if(op) {
+			unsigned j = (unsigned) py_string_hash(op) & (size - 1);
+
+			while(py_string_interned[j]) j = (j + 1) & (size - 1);
+
+			py_string_interned[j] = op;
+		}
+	}
+
+	free(old);
+	return 0;
+}
+
+/*
+ * Finds the slot for a string about to be interned, making room for it
+ * first if need be.
+ */
+static struct py_object** py_string_intern_slot(
+		const char* str, unsigned size, unsigned long hash) {
+
+	if((py_string_interned_used + 1) * 3 >= py_string_interned_size * 2) {
+		if(py_string_intern_grow() == -1) return 0;
+	}
+
+	return py_string_intern_look(str, size, hash);
+}
+
 struct py_object* py_string_new_size(const char* str, unsigned size) {
 	struct py_string* op;
 
-	if(!(op = malloc(sizeof(struct py_string) + size))) return 0;
-
-	py_object_newref(op);
-	op->ob.type = PY_TYPE_STRING;
-	op->ob.size = size;
+	if(!(op = py_varobject_new(PY_TYPE_STRING, size))) return 0;
 
 	memcpy(op->value, str, size);
 
 	op->value[size] = '\0';
+	op->hash = 0;
 
 	return (void*) op;
 }
@@ -29,14 +109,92 @@ struct py_object* py_string_new(const char* str) {
 	return py_string_new_size(str, (unsigned) strlen(str));
 }
 
+/* Returns a new reference to the interned string equal to `str'. */
+struct py_object* py_string_intern(const char* str) {
+	unsigned size = (unsigned) strlen(str);
+	unsigned long hash = py_string_hash_size(str, size);
+	struct py_object** slot;
+
+	if(!(slot = py_string_intern_slot(str, size, hash))) return 0;
+
+	if(!*slot) {
+		if(!(*slot = py_string_new_size(str, size))) return 0;
+		py_string_interned_used++;
+	}
+
+	return py_object_incref(*slot);
+}
+
+/*
+ * Replaces the string at `p' with the interned string equal to it, which it
+ * becomes itself if there is none yet. The reference at `p' is carried over.
+ */
+int py_string_intern_object(struct py_object** p) {
+	struct py_object* op = *p;
+	struct py_object** slot;
+
+	slot = py_string_intern_slot(
+			py_string_get(op), py_varobject_size(op), py_string_hash(op));
+
+	if(!slot) return -1;
+
+	if(!*slot) {
+		*slot = py_object_incref(op);
+		py_string_interned_used++;
+	}
+	else if(*slot != op) {
+		*p = py_object_incref(*slot);
+		py_object_decref(op);
+	}
+
+	return 0;
+}
+
 void py_string_dealloc(struct py_object* op) {
-	free(op);
+	py_object_delete(op);
 }
 
 const char* py_string_get(const struct py_object* op) {
 	return ((struct py_string*) op)->value;
 }
 
+/*
+ * FNV-1a, on as many bits as a long has -- simple, quick and spreading keys
+ * which differ in one character, as names often do, over the low bits that
+ * power-of-two tables index by.
+ */
+#if ULONG_MAX > 0xFFFFFFFFUL
+# define PY_STRING_HASH_BASIS (14695981039346656037UL)
+# define PY_STRING_HASH_PRIME (1099511628211UL)
+#else
+# define PY_STRING_HASH_BASIS (2166136261UL)
+# define PY_STRING_HASH_PRIME (16777619UL)
+#endif
+
+unsigned long py_string_hash_size(const char* str, unsigned size) {
+	const unsigned char* p = (const unsigned char*) str;
+	unsigned long hash = PY_STRING_HASH_BASIS;
+
+	while(size--) {
+		hash ^= *p++;
+		hash *= PY_STRING_HASH_PRIME;
+	}
+
+	return hash;
+}
+
+/*
+ * Computed on first use and kept with the string. A string whose hash comes
+ * out as 0 just computes it every time.
+ */
+unsigned long py_string_hash(struct py_object* op) {
+	struct py_string* sp = (struct py_string*) op;
+
+	if(!sp->hash) sp->hash = py_string_hash_size(sp->value, sp->ob.size);
+
+	return sp->hash;
+}
+
 /* Methods */
 
 struct py_object* py_string_cat(struct py_object* a, struct py_object* b) {
@@ -51,16 +209,13 @@ struct py_object* py_string_cat(struct py_object* a, struct py_object* b) {
 	if(sz_b == 0) return py_object_incref(a);
 
 	/* TODO: Not using _new_size? */
-	if(!(op = malloc(sizeof(struct py_string) + size))) return 0;
-
-	py_object_newref(op);
-	op->ob.type = PY_TYPE_STRING;
-	op->ob.size = size;
+	if(!(op = py_varobject_new(PY_TYPE_STRING, size))) return 0;
 
 	memcpy(op->value, py_string_get(a), sz_a);
 	memcpy(op->value + sz_a, py_string_get(b), sz_b);
 
 	op->value[size] = '\0';
+	op->hash = 0;
 
 	return (void*) op;
 }
@@ -97,3 +252,17 @@ int py_string_cmp(const struct py_object* a, const struct py_object* b) {
 
 	return 0;
 }
+
+void py_string_done(void) {
+	unsigned i;
+
+	for(i = 0; i < py_string_interned_size; i++) {
+		py_object_decref(py_string_interned[i]);
+	}
+
+	free(py_string_interned);
+
+	py_string_interned = 0;
+	py_string_interned_size = 0;
+	py_string_interned_used = 0;
+}
@@ -6,18 +6,48 @@
 /* Tuple object implementation */
 
 #include <python/std.h>
+#include <python/gc.h>
 
 #include <python/object/tuple.h>
 
+/*
+ * Argument tuples are made and dropped on every call taking more than one
+ * argument, so released small tuples are kept on a free list per size (up to
+ * a limit) and reused before going back to the allocator. There is only ever
+ * one empty tuple, which is immortal.
+ */
+
+#define PY_TUPLE_FREE_MAX (8) /* Largest size kept on a free list */
+#define PY_TUPLE_KEEP (128) /* Tuples kept on each free list */
+
+/* TODO: Python global state. */
+static struct py_tuple* py_tuple_freelist[PY_TUPLE_FREE_MAX + 1];
+static unsigned py_tuple_freecount[PY_TUPLE_FREE_MAX + 1];
+static struct py_object* py_tuple_empty = 0;
+
 struct py_object* py_tuple_new(unsigned size) {
 	struct py_tuple* op;
 
-	op = calloc(1, sizeof(struct py_tuple) + size * sizeof(struct py_object*));
-	if(!op) return 0;
+	if(!size && py_tuple_empty) return py_tuple_empty;
 
-	py_object_newref(op);
-	op->ob.type = PY_TYPE_TUPLE;
-	op->ob.size = size;
+	if(size && size <= PY_TUPLE_FREE_MAX && (op = py_tuple_freelist[size])) {
+		py_tuple_freelist[size] = *(struct py_tuple**) op;
+		py_tuple_freecount[size]--;
+
+		py_object_newref(op);
+		op->ob.type = PY_TYPE_TUPLE;
+		op->ob.size = size;
+
+		py_gc_track(op);
+	}
+	else if(!(op = py_varobject_new(PY_TYPE_TUPLE, size))) return 0;
+
+	memset(op->item, 0, size * sizeof(struct py_object*));
+
+	if(!size) {
+		py_object_immortalise(op);
+		py_tuple_empty = (void*) op;
+	}
 
 	return (void*) op;
 }
@@ -36,13 +66,49 @@ void py_tuple_set(struct py_object* op, unsigned i, struct py_object* item) {
 /* Methods */
 
 void py_tuple_dealloc(struct py_object* op) {
-	unsigned i;
+	unsigned i, size = py_varobject_size(op);
 
-	for(i = 0; i < py_varobject_size(op); i++) {
+	for(i = 0; i < size; i++) {
 		py_object_decref(((struct py_tuple*) op)->item[i]);
 	}
 
-	free(op);
+	if(size && size <= PY_TUPLE_FREE_MAX &&
+		py_tuple_freecount[size] < PY_TUPLE_KEEP) {
+
+		py_gc_untrack(op);
+
+		*(struct py_tuple**) op = py_tuple_freelist[size];
+		py_tuple_freelist[size] = (void*) op;
+		py_tuple_freecount[size]++;
+	}
+	else py_object_delete(op);
+}
+
+void py_tuple_done(void) {
+	unsigned i;
+
+	for(i = 1; i <= PY_TUPLE_FREE_MAX; i++) {
+		while(py_tuple_freelist[i]) {
+			struct py_tuple* op = py_tuple_freelist[i];
+
+			py_tuple_freelist[i] = *(struct py_tuple**) op;
+
+			/* The link took the place of the header. */
+			op->ob.type = PY_TYPE_TUPLE;
+			op->ob.size = i;
+			py_object_delete((void*) op);
+		}
+
+		py_tuple_freecount[i] = 0;
+	}
+}
+
+void py_tuple_traverse(struct py_object* op, py_visit_t visit, void* arg) {
+	unsigned i;
+
+	for(i = 0; i < py_varobject_size(op); i++) {
+		visit(&((struct py_tuple*) op)->item[i], arg);
+	}
 }
 
 int py_tuple_cmp(const struct py_object* v, const struct py_object* w) {
@@ -65,6 +131,22 @@ int py_tuple_cmp(const struct py_object* v, const struct py_object* w) {
 	return (int) (a - b);
 }
 
+/* Only called for tuples holding nothing unhashable -- see `py_object_hash'. */
+unsigned long py_tuple_hash(struct py_object* op) {
+	struct py_tuple* tp = (void*) op;
+	unsigned long hash = py_varobject_size(op);
+	unsigned i;
+
+	for(i = 0; i < tp->ob.size; i++) {
+		struct py_object* item = tp->item[i];
+
+		hash ^= py_types[PY_TYPE(item)].hash(item);
+		hash *= PY_HASH_MULTIPLIER;
+	}
+
+	return hash;
+}
+
 struct py_object* py_tuple_ind(struct py_object* op, unsigned i) {
 	return py_object_incref(((struct py_tuple*) op)->item[i]);
 }
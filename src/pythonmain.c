@@ -11,13 +11,17 @@
 #include <python/compile.h>
 #include <python/ceval.h>
 
+#include <python/object/frame.h>
+
 struct py_object* py_tree_run(
 		struct py_env* env, struct py_node* n, const char* filename,
 		struct py_object* globals, struct py_object* locals) {
 
 	if(!globals) {
 		globals = env->current ? env->current->globals : 0;
-		if(!locals) locals = env->current ? env->current->locals : 0;
+		if(!locals) {
+			locals = env->current ? py_frame_get_locals(env->current) : 0;
+		}
 	}
 	else if(!locals) locals = globals;
 
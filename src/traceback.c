@@ -31,8 +31,10 @@ static struct py_traceback* py_traceback_new_frame(
 	return traceback;
 }
 
-int py_traceback_new(struct py_frame* frame, unsigned line) {
+/* `offset' is that of the failed instruction in the frame's code. */
+int py_traceback_new(struct py_frame* frame, unsigned offset) {
 	struct py_traceback* traceback;
+	unsigned line = py_code_get_line(frame->code, offset);
 
 	traceback = py_traceback_new_frame(py_traceback_current, frame, line);
 	if(!traceback) return -1;
@@ -101,7 +103,10 @@ void py_traceback_print(struct py_object* object) {
 
 		asys_log(__FILE__, "`%s:%d':", file, traceback->lineno);
 
-		py_traceback_print_line(file, traceback->lineno);
+		/* Code compiled without line information. */
+		if(traceback->lineno) {
+			py_traceback_print_line(file, traceback->lineno);
+		}
 
 		traceback = traceback->next;
 	}
@@ -113,5 +118,5 @@ void py_traceback_dealloc(struct py_object* op) {
 	py_object_decref(tb->next);
 	py_object_decref(tb->frame);
 
-	free(op);
+	py_object_delete(op);
 }
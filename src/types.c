@@ -16,74 +16,111 @@
 #include <python/object/tuple.h>
 #include <python/object/list.h>
 #include <python/object/string.h>
+#include <python/object/range.h>
 #include <python/object/dict.h>
 #include <python/object/int.h>
 #include <python/object/float.h>
 
 struct py_type_info py_types[PY_TYPE_MAX] = {
 		/* Type */
-		{ sizeof(struct py_type_info), 0, 0, 0, 0, 0 },
+		{ sizeof(struct py_type_info), 0, 0, 0, 0, 0, 0, 0, 0 },
 		/* None */
 		{ 0 },
 
 		/* Class */
-		{ sizeof(struct py_class), py_class_dealloc, 0, 0, 0, 0 },
+		{
+				sizeof(struct py_class), 0,
+				py_class_dealloc, 0, 0, 0, 0, py_class_traverse, 0
+		},
 		/* Class Member */
-		{ sizeof(struct py_class_member), py_class_member_dealloc, 0, 0, 0, 0 },
+		{
+				sizeof(struct py_class_member), 0,
+				py_class_member_dealloc, 0, 0, 0, 0, py_class_member_traverse, 0
+		},
 		/* Class Method */
-		{ sizeof(struct py_class_method), py_class_method_dealloc, 0, 0, 0, 0 },
+		{
+				sizeof(struct py_class_method), 0,
+				py_class_method_dealloc, 0, 0, 0, 0, py_class_method_traverse, 0
+		},
 
 		/* Code */
-		{ sizeof(struct py_code), py_code_dealloc, 0, 0, 0, 0 },
+		{ sizeof(struct py_code), 0, py_code_dealloc, 0, 0, 0, 0, 0, 0 },
 		/* Frame */
-		{ sizeof(struct py_frame), py_frame_dealloc, 0, 0, 0, 0 },
+		{
+				sizeof(struct py_frame), 0,
+				py_frame_dealloc, 0, 0, 0, 0, py_frame_traverse, 0
+		},
 		/* Traceback */
-		{ sizeof(struct py_traceback), py_traceback_dealloc, 0, 0, 0, 0 },
+		{
+				sizeof(struct py_traceback), 0,
+				py_traceback_dealloc, 0, 0, 0, 0, 0, 0
+		},
 		/* Func */
-		{ sizeof(struct py_func), py_func_dealloc, 0, 0, 0, 0 },
+		{
+				sizeof(struct py_func), 0,
+				py_func_dealloc, 0, 0, 0, 0, py_func_traverse, 0
+		},
 		/* Method */
-		{ sizeof(struct py_method), py_method_dealloc, 0, 0, 0, 0 },
+		{
+				sizeof(struct py_method), 0,
+				py_method_dealloc, 0, 0, 0, 0, py_method_traverse, 0
+		},
 		/* Module */
-		{ sizeof(struct py_module), py_module_dealloc, 0, 0, 0, 0 },
+		{
+				sizeof(struct py_module), 0,
+				py_module_dealloc, 0, 0, 0, 0, py_module_traverse, 0
+		},
 
 		/* Tuple */
 		{
-				sizeof(struct py_tuple),
+				sizeof(struct py_tuple), sizeof(struct py_object*),
 				py_tuple_dealloc, py_tuple_cmp,
-				py_tuple_cat, py_tuple_ind, py_tuple_slice
+				py_tuple_cat, py_tuple_ind, py_tuple_slice,
+				py_tuple_traverse, py_tuple_hash
 		},
 		/* List */
 		{
-				sizeof(struct py_list),
+				sizeof(struct py_list), 0,
 				py_list_dealloc, py_list_cmp,
-				py_list_cat, py_list_ind, py_list_slice
+				py_list_cat, py_list_ind, py_list_slice,
+				py_list_traverse, 0
 		},
 		/* String */
 		{
-				sizeof(struct py_string),
+				sizeof(struct py_string) + 1, sizeof(char), /* NUL */
 				py_string_dealloc, py_string_cmp,
-				py_string_cat, py_string_ind, py_string_slice
+				py_string_cat, py_string_ind, py_string_slice,
+				0, py_string_hash
+		},
+		/* Range */
+		{
+				sizeof(struct py_range), 0,
+				py_range_dealloc, py_range_cmp,
+				0, py_range_ind, py_range_slice, 0, 0
 		},
 
 		/* Dict */
 		{
-				sizeof(struct py_dict),
-				py_dict_dealloc, 0, 0, 0, 0
+				sizeof(struct py_dict), 0,
+				py_dict_dealloc, 0, 0, 0, 0, py_dict_traverse, 0
 		},
 
 		/* Int */
 		{
-				sizeof(struct py_int),
-				py_int_dealloc, py_int_cmp, 0, 0, 0
+				sizeof(struct py_int), 0,
+				py_int_dealloc, py_int_cmp, 0, 0, 0, 0, py_int_hash
 		},
 		/* Float */
 		{
-				sizeof(struct py_float),
-				py_float_dealloc, py_float_cmp, 0, 0, 0
+				sizeof(struct py_float), 0,
+				py_float_dealloc, py_float_cmp, 0, 0, 0, 0, py_float_hash
 		},
 };
 
 enum py_result py_types_register(struct py* py) {
 	(void) py;
+
+	py_int_init();
+
 	return PY_RESULT_OK;
 }